@@ -0,0 +1,72 @@
+#pragma once
+#include "difference_detector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace vv
+{
+
+	// Average magnitude difference function: first local minimum close to the global one.
+	// Like YIN without the squaring or normalization; less robust against octave errors.
+	template <class T>
+	class amdf_detector : public difference_detector<T>
+	{
+	public:
+
+		amdf_detector(double sampleRate, std::size_t frame_size)
+			: difference_detector<T>(sampleRate, frame_size)
+		{
+		}
+
+		pitch_mark detect(const T* input) override
+		{
+			auto d = this->differences(input, [](T v)
+			{
+				return std::abs(v);
+			});
+
+			auto minimum_value = d[range_.minimum];
+			T mean = 0;
+
+			for (std::size_t tau = range_.minimum; tau < range_.maximum; ++tau)
+			{
+				minimum_value = std::min(minimum_value, d[tau]);
+				mean += d[tau];
+			}
+
+			pitch_mark mark;
+
+			if (range_.maximum <= range_.minimum)
+				return mark;
+
+			mean /= static_cast<T>(range_.maximum - range_.minimum);
+
+			if (mean <= 0)
+				return mark;
+
+			// Subharmonic lags are nearly as deep as the true period, so take the first dip close to the minimum.
+			auto threshold = minimum_value + static_cast<T>(0.1) * (mean - minimum_value);
+
+			for (std::size_t tau = range_.minimum; tau < range_.maximum; ++tau)
+			{
+				if (d[tau] > threshold)
+					continue;
+
+				auto best = this->deepest(d, tau, [&](T v) { return v <= threshold; });
+
+				mark.period = static_cast<std::uint32_t>(best);
+				mark.confidence = static_cast<float>(1 - d[best] / mean);
+				break;
+			}
+
+			return mark;
+		}
+
+	private:
+
+		using difference_detector<T>::range_;
+
+	};
+
+}
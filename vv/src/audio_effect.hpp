@@ -1,11 +1,14 @@
 #pragma once
 #include "edit_controller.hpp"
-#include "processor.hpp"
+#include "stream.hpp"
 #include <public.sdk/source/vst/vstaudioeffect.h>
 #include <pluginterfaces/vst/ivstparameterchanges.h>
 #include <pluginterfaces/base/ibstream.h>
-#include <boost/circular_buffer.hpp>
-#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
 
 namespace vv
 {
@@ -22,10 +25,35 @@ namespace vv
 
 			this->addAudioInput(STR16("AudioInput"), Steinberg::Vst::SpeakerArr::kMono);
 			this->addAudioOutput(STR16("AudioOutput"), Steinberg::Vst::SpeakerArr::kMono);
+
+			// Hosts never drain the ring, so the plugin writes the trace itself when asked to.
+			if (auto dir = std::getenv("VV_TRACE_DIR"))
+			{
+				if (*dir)
+				{
+					// streams set up before a previous terminate() may still hold an existing ring
+					auto allocated = !trace_;
+
+					if (allocated)
+						trace_ = std::make_unique<trace_ring>();
+
+					recorder_ = trace_recorder::open(*trace_, trace_path(dir), "vv");
+
+					if (!recorder_ && allocated)
+						trace_.reset();
+				}
+			}
 			
 			return Steinberg::kResultOk;
 		}
 
+		Steinberg::tresult PLUGIN_API terminate() override
+		{
+			recorder_.reset();
+
+			return Steinberg::Vst::AudioEffect::terminate();
+		}
+
 		Steinberg::tresult PLUGIN_API setBusArrangements(
 			Steinberg::Vst::SpeakerArrangement* inputs, Steinberg::int32 numIns,
 			Steinberg::Vst::SpeakerArrangement* outputs, Steinberg::int32 numOuts) override
@@ -48,6 +76,20 @@ namespace vv
 			if (ret != Steinberg::kResultOk)
 				return ret;
 
+			// absent in states saved before the detector parameter existed
+			Steinberg::int32 detector_read = 0;
+			ret = state->read(&detector_raw_, sizeof(detector_raw_), &detector_read);
+			if (ret != Steinberg::kResultOk || detector_read != sizeof(detector_raw_))
+				detector_raw_ = 0.0;
+
+			// absent in states saved before the input pitch was persisted
+			Steinberg::int32 input_pitch_read = 0;
+			ret = state->read(&input_pitch_raw_, sizeof(input_pitch_raw_), &input_pitch_read);
+			if (ret != Steinberg::kResultOk || input_pitch_read != sizeof(input_pitch_raw_))
+				input_pitch_raw_ = 0.0;
+
+			set_detector(to_detector_type(detector_raw_));
+
 			return Steinberg::kResultOk;
 		}
 
@@ -63,14 +105,48 @@ namespace vv
 			if (ret != Steinberg::kResultOk)
 				return ret;
 
+			ret = state->write(&detector_raw_, sizeof(detector_raw_));
+			if (ret != Steinberg::kResultOk)
+				return ret;
+
+			ret = state->write(&input_pitch_raw_, sizeof(input_pitch_raw_));
+			if (ret != Steinberg::kResultOk)
+				return ret;
+
 			return Steinberg::kResultOk;
 		}
 
+		Steinberg::tresult PLUGIN_API canProcessSampleSize(Steinberg::int32 symbolicSampleSize) override
+		{
+			if (symbolicSampleSize == Steinberg::Vst::kSample32 || symbolicSampleSize == Steinberg::Vst::kSample64)
+				return Steinberg::kResultTrue;
+
+			return Steinberg::kResultFalse;
+		}
+
 		Steinberg::tresult PLUGIN_API setupProcessing(Steinberg::Vst::ProcessSetup& setup) override
 		{
 			try
 			{
-				processor_ = std::make_unique<processor>(setup.sampleRate);
+				// Only the width the host asked for is built, so each path keeps its own plans and buffers.
+				stream32_.reset();
+				stream64_.reset();
+				pool_.reset();
+
+				// Offline renders have no deadline, so trade latency for throughput: one frame per thread per batch,
+				// up to the stream's cap. All instances share one pool.
+				std::size_t batch_frames = 1;
+
+				if (setup.processMode == Steinberg::Vst::kOffline)
+				{
+					pool_ = thread_pool::shared();
+					batch_frames = pool_->concurrency();
+				}
+
+				if (setup.symbolicSampleSize == Steinberg::Vst::kSample64)
+					stream64_ = make_stream<double>(setup.sampleRate, batch_frames);
+				else
+					stream32_ = make_stream<float>(setup.sampleRate, batch_frames);
 			}
 			catch (...)
 			{
@@ -80,11 +156,24 @@ namespace vv
 			return Steinberg::kResultOk;
 		}
 
+		Steinberg::uint32 PLUGIN_API getLatencySamples() override
+		{
+			if (stream32_)
+				return static_cast<Steinberg::uint32>(stream32_->latency());
+
+			if (stream64_)
+				return static_cast<Steinberg::uint32>(stream64_->latency());
+
+			return 0;
+		}
+
 		Steinberg::tresult PLUGIN_API process(Steinberg::Vst::ProcessData& data) override
 		{
-			if (!processor_)
+			if (!stream32_ && !stream64_)
 				return Steinberg::kResultFalse;
 
+			trace_scope block(trace_.get(), "process", trace_category::process, static_cast<double>(data.numSamples));
+
 			if (data.inputParameterChanges)
 			{
 				auto count = data.inputParameterChanges->getParameterCount();
@@ -109,62 +198,132 @@ namespace vv
 						case edit_controller::formant_tag:
 							formant_shift_raw_ = value;
 							break;
+						case edit_controller::input_pitch_tag:
+							input_pitch_raw_ = value;
+							break;
+						case edit_controller::detector_tag:
+							detector_raw_ = value;
+							set_detector(to_detector_type(value));
+							break;
 						}
+
+						auto name = parameter_name(tag);
+
+						if (trace_ && name)
+							trace_->push(name, trace_category::parameter, trace_now(), 0, value);
 					}
 				}
 			}
 
-			auto in = data.inputs[0].channelBuffers32[0];
-			auto out = data.outputs[0].channelBuffers32[0];
-
-			std::size_t remain = data.numSamples;
+			if (data.symbolicSampleSize == Steinberg::Vst::kSample64)
+			{
+				if (!stream64_)
+					return Steinberg::kResultFalse;
 
-			while (remain != 0)
+				process_samples(*stream64_, data.inputs[0].channelBuffers64[0], data.outputs[0].channelBuffers64[0], data.numSamples);
+			}
+			else
 			{
-				if (in_buffer_.full())
-				{
-					std::copy(in_buffer_.begin(), in_buffer_.end(), temp_input_.begin());
+				if (!stream32_)
+					return Steinberg::kResultFalse;
 
-					auto pitch_shift = std::pow(2.0, (pitch_shift_raw_ - 0.5) * 2.0);
-					auto formant_shift = std::pow(2.0, (formant_shift_raw_ - 0.5) * 2.0);
+				process_samples(*stream32_, data.inputs[0].channelBuffers32[0], data.outputs[0].channelBuffers32[0], data.numSamples);
+			}
 
-					(*processor_)(temp_input_.data(), temp_output_.data(), pitch_shift, formant_shift);
+			return Steinberg::kResultOk;
+		}
 
-					out_buffer_.assign(temp_output_.begin(), temp_output_.end());
-					in_buffer_.clear();
-				}
+		static Steinberg::FUnknown* create_instance(void*)
+		{
+			return static_cast<Steinberg::Vst::IAudioProcessor*>(new audio_effect());
+		}
 
-				auto size = std::min(processor::buffer_size - in_buffer_.size(), remain);
+		// Starts recording process() events into a ring, for a host that drains them from its own non-real-time thread.
+		// Without a consumer nothing is allocated or recorded. Call before setupProcessing, which hands the ring to the streams.
+		// Returns null while the plugin writes events to VV_TRACE_DIR itself, since the ring takes only one consumer.
+		trace_ring* enable_trace()
+		{
+			if (recorder_)
+				return nullptr;
 
-				std::copy(in, in + size, std::back_inserter(in_buffer_));
-				std::copy(out_buffer_.begin(), out_buffer_.begin() + size, out);
+			if (!trace_)
+				trace_ = std::make_unique<trace_ring>();
 
-				out_buffer_.rresize(out_buffer_.size() - size);
+			return trace_.get();
+		}
 
-				in += size;
-				out += size;
-				remain -= size;
-			}
+	private:
 
-			return Steinberg::kResultOk;
+		template <class T>
+		std::unique_ptr<stream<T>> make_stream(double sampleRate, std::size_t batch_frames)
+		{
+			auto fft = processor<T>::plan_fft(sampleRate);
+			auto result = std::make_unique<stream<T>>(sampleRate, fft, batch_frames, pool_.get());
+
+			result->set_detector(to_detector_type(detector_raw_));
+			result->set_trace(trace_.get());
+
+			return result;
 		}
 
-		static Steinberg::FUnknown* create_instance(void*)
+		template <class T>
+		void process_samples(stream<T>& target, const T* in, T* out, std::size_t count)
 		{
-			return static_cast<Steinberg::Vst::IAudioProcessor*>(new audio_effect());
+			target.process(in, out, count, [&]()
+			{
+				frame_settings settings;
+				settings.pitch_shift = std::pow(2.0, (pitch_shift_raw_ - 0.5) * 2.0);
+				settings.formant_shift = std::pow(2.0, (formant_shift_raw_ - 0.5) * 2.0);
+				settings.input_hz = input_pitch_raw_ * edit_controller::input_pitch_max_hz;
+
+				return settings;
+			});
 		}
 
-	private:
+		void set_detector(detector_type type)
+		{
+			if (stream32_)
+				stream32_->set_detector(type);
 
-		audio_effect()
-			: in_buffer_(processor::buffer_size)
-			, out_buffer_(processor::buffer_size)
-			, temp_input_(processor::buffer_size)
-			, temp_output_(processor::buffer_size)
+			if (stream64_)
+				stream64_->set_detector(type);
+		}
+
+		// one file per instance and session, so instances in the same host do not overwrite each other
+		static std::string trace_path(const char* dir)
 		{
-			for (std::size_t i = 0; i < processor::buffer_size; ++i)
-				in_buffer_.push_back(0.0f);
+			static std::atomic<unsigned int> instances{ 0 };
+
+			auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+			return std::string(dir) + "/vv_trace_" + std::to_string(time) + "_" + std::to_string(instances++) + ".json";
+		}
 
+		static detector_type to_detector_type(double value)
+		{
+			auto index = static_cast<std::size_t>(std::round(value * static_cast<double>(detector_type_count - 1)));
+			return static_cast<detector_type>(std::min(index, detector_type_count - 1));
+		}
+
+		static const char* parameter_name(Steinberg::Vst::ParamID tag)
+		{
+			switch (tag)
+			{
+			case edit_controller::pitch_tag:
+				return "pitch";
+			case edit_controller::formant_tag:
+				return "formant";
+			case edit_controller::input_pitch_tag:
+				return "input_pitch";
+			case edit_controller::detector_tag:
+				return "detector";
+			}
+
+			return nullptr;
+		}
+
+		audio_effect()
+		{
 			this->setControllerClass(edit_controller_uid);
 		}
 
@@ -172,15 +331,22 @@ namespace vv
 		{
 		}
 
-		boost::circular_buffer<float> in_buffer_;
-		boost::circular_buffer<float> out_buffer_;
-		std::vector<float> temp_input_;
-		std::vector<float> temp_output_;
-
 		double pitch_shift_raw_ = 0.5;
 		double formant_shift_raw_ = 0.5;
+		double input_pitch_raw_ = 0.0;
+		double detector_raw_ = 0.0;
+
+		// declared before the streams, which hold a pointer to it
+		std::shared_ptr<thread_pool> pool_;
+
+		std::unique_ptr<stream<float>> stream32_;
+		std::unique_ptr<stream<double>> stream64_;
+
+		// null unless VV_TRACE_DIR is set or the host called enable_trace()
+		std::unique_ptr<trace_ring> trace_;
 
-		std::unique_ptr<processor> processor_;
+		// declared after the ring it drains, so it stops first
+		std::unique_ptr<trace_recorder> recorder_;
 
 	};
 
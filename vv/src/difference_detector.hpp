@@ -0,0 +1,62 @@
+#pragma once
+#include "pitch_detector.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace vv
+{
+
+	// Base of the time-domain detectors, which compare a window from the middle of the frame with itself
+	// at every searched lag and differ only in the difference function and how its minimum is picked.
+	template <class T>
+	class difference_detector : public pitch_detector<T>
+	{
+	public:
+
+		static const std::size_t window_divisor = 4;
+
+	protected:
+
+		difference_detector(double sampleRate, std::size_t frame_size)
+			: range_(search_range(sampleRate, frame_size / 2 - 2))
+			, window_size_(frame_size / window_divisor)
+			, lags_(round_up_to_lanes(range_.maximum + 2))
+			, offset_((frame_size - window_size_ - lags_) / 2)
+			, difference_(lags_)
+		{
+		}
+
+		// d[tau] = sum of f(x[j] - x[j + tau]) over the window, for every lag below lags_.
+		template <class F>
+		T* differences(const T* input, F f)
+		{
+			auto d = difference_.data();
+			accumulate_differences(input + offset_, window_size_, d, lags_, f);
+			return d;
+		}
+
+		// Deepest point of the dip that starts at begin and lasts while in_dip(d[tau]) holds;
+		// noise makes spurious local minima on its slopes, so its first minimum is not necessarily the bottom.
+		template <class F>
+		std::size_t deepest(const T* d, std::size_t begin, F in_dip) const
+		{
+			auto best = begin;
+
+			for (auto tau = begin; tau < range_.maximum && in_dip(d[tau]); ++tau)
+			{
+				if (d[tau] < d[best])
+					best = tau;
+			}
+
+			return best;
+		}
+
+		period_range range_;
+		std::size_t window_size_;
+		std::size_t lags_;
+		std::size_t offset_;
+		std::vector<T> difference_;
+
+	};
+
+}
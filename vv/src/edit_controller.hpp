@@ -11,6 +11,11 @@ namespace vv
 
 		static const int pitch_tag = 1;
 		static const int formant_tag = 2;
+		static const int input_pitch_tag = 3;
+		static const int detector_tag = 4;
+
+		// Upper end of the input pitch parameter; 0 Hz means the pitch is detected from the input.
+		static constexpr double input_pitch_max_hz = 1000.0;
 
 		Steinberg::tresult PLUGIN_API initialize(Steinberg::FUnknown* context) override
 		{
@@ -20,6 +25,13 @@ namespace vv
 
 			this->parameters.addParameter(STR16("Pitch"), STR16(""), 0, 0.5, Steinberg::Vst::ParameterInfo::kCanAutomate, pitch_tag);
 			this->parameters.addParameter(STR16("Formant"), STR16(""), 0, 0.5, Steinberg::Vst::ParameterInfo::kCanAutomate, formant_tag);
+			this->parameters.addParameter(new Steinberg::Vst::RangeParameter(STR16("Input Pitch"), input_pitch_tag, STR16("Hz"), 0.0, input_pitch_max_hz, 0.0));
+
+			auto detector = new Steinberg::Vst::StringListParameter(STR16("Detector"), detector_tag, nullptr, Steinberg::Vst::ParameterInfo::kIsList);
+			detector->appendString(STR16("NSDF"));
+			detector->appendString(STR16("YIN"));
+			detector->appendString(STR16("AMDF"));
+			this->parameters.addParameter(detector);
 
 			return Steinberg::kResultOk;
 		}
@@ -38,12 +50,27 @@ namespace vv
 			if (ret != Steinberg::kResultOk)
 				return ret;
 
+			// absent in states saved before the detector parameter existed
+			double detector = 0.0;
+			Steinberg::int32 detector_read = 0;
+			if (state->read(&detector, sizeof(detector), &detector_read) != Steinberg::kResultOk || detector_read != sizeof(detector))
+				detector = 0.0;
+
+			// absent in states saved before the input pitch was persisted
+			double input_pitch = 0.0;
+			Steinberg::int32 input_pitch_read = 0;
+			if (state->read(&input_pitch, sizeof(input_pitch), &input_pitch_read) != Steinberg::kResultOk || input_pitch_read != sizeof(input_pitch))
+				input_pitch = 0.0;
+
 			pitch_shift = this->plainParamToNormalized(pitch_tag, pitch_shift);
 			this->setParamNormalized(pitch_tag, pitch_shift);
 
 			formant_shift = this->plainParamToNormalized(formant_tag, formant_shift);
 			this->setParamNormalized(formant_tag, formant_shift);
 
+			this->setParamNormalized(detector_tag, detector);
+			this->setParamNormalized(input_pitch_tag, input_pitch);
+
 			return Steinberg::kResultOk;
 		}
 
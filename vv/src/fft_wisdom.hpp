@@ -0,0 +1,365 @@
+#pragma once
+#include "kissfft.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <complex>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace vv
+{
+
+	// Transform size, factorization and forward algorithm used for the NSDF autocorrelation.
+	// With real_input the forward transform packs the real frame into a half-size complex transform;
+	// otherwise it is a full-size complex transform pruned to the kept band.
+	struct fft_config
+	{
+		std::size_t size;
+		std::size_t first_radix;
+		bool real_input = false;
+	};
+
+	template <class T>
+	struct scalar_name;
+
+	template <>
+	struct scalar_name<float>
+	{
+		static const char* get() { return "float"; }
+	};
+
+	template <>
+	struct scalar_name<double>
+	{
+		static const char* get() { return "double"; }
+	};
+
+	// Wisdom entries of every sample type, and the file they persist to. One lock covers both types,
+	// and saving merges with what is on disk, so neither type (nor another process) loses the other's entries.
+	// The first line reads "vv_fft_wisdom <version>", each following line
+	// "<scalar> <minimum size> <bins> <size> <first radix> <real input>".
+	class fft_wisdom_store
+	{
+	public:
+
+		// Bump whenever the benchmark or the candidates change, so wisdom measured the old way is measured again.
+		static const int version = 3;
+
+		using key_type = std::tuple<std::string, std::size_t, std::size_t>;
+		using entry_map = std::map<key_type, fft_config>;
+
+		// Configurations the benchmark chooses from. Anything else found in the wisdom file is ignored.
+		// The transform size is never tuned: it sets the spectral grid the NSDF low-pass is cut on,
+		// so a size picked per machine would make detected periods (and the rendered audio) machine-dependent.
+		static std::vector<fft_config> candidates(std::size_t minimum_size)
+		{
+			std::vector<fft_config> result;
+
+			for (bool real_input : { true, false })
+			{
+				if (real_input && minimum_size % 2 != 0)
+					continue;
+
+				for (std::size_t first_radix : { 4, 2 })
+				{
+					fft_config config{ minimum_size, first_radix };
+					config.real_input = real_input;
+					result.push_back(config);
+				}
+			}
+
+			return result;
+		}
+
+		// Per-user cache location, or an empty string when there is none (wisdom is then kept in memory only).
+		// Shared directories such as /tmp are never used, so other users cannot plant or redirect the file.
+		static std::string path()
+		{
+			if (auto path = std::getenv("VV_FFT_WISDOM"))
+				return path;
+
+#if defined(_WIN32)
+			for (auto name : { "LOCALAPPDATA", "TEMP", "TMP" })
+			{
+				if (auto dir = std::getenv(name))
+					return std::string(dir) + "\\vv_fft_wisdom.txt";
+			}
+#else
+			if (auto dir = std::getenv("XDG_CACHE_HOME"))
+			{
+				if (*dir == '/')
+					return std::string(dir) + "/vv_fft_wisdom.txt";
+			}
+
+			if (auto dir = std::getenv("HOME"))
+			{
+				if (*dir == '/')
+					return std::string(dir) + "/.cache/vv_fft_wisdom.txt";
+			}
+#endif
+
+			return std::string();
+		}
+
+		// Returns the entry for key, measuring it with measure() and saving it to file when there is none yet.
+		// An empty file keeps the entry in memory only.
+		template <class Measure>
+		static fft_config find_or_measure(const std::string& file, const key_type& key, Measure measure)
+		{
+			std::lock_guard<std::mutex> lock(mutex());
+
+			auto& loaded = cache();
+
+			auto found = loaded.find(file);
+			if (found == loaded.end())
+				found = loaded.emplace(file, file.empty() ? entry_map() : read(file)).first;
+
+			auto& entries = found->second;
+
+			auto it = entries.find(key);
+			if (it != entries.end())
+				return it->second;
+
+			auto config = measure();
+			entries[key] = config;
+
+			if (!file.empty())
+			{
+				// another process may have added entries since they were read
+				auto merged = read(file);
+
+				for (const auto& entry : entries)
+					merged[entry.first] = entry.second;
+
+				write(file, merged);
+				entries = std::move(merged);
+			}
+
+			return config;
+		}
+
+	private:
+
+		static std::mutex& mutex()
+		{
+			static std::mutex instance;
+			return instance;
+		}
+
+		// entries per wisdom file, loaded on first use
+		static std::map<std::string, entry_map>& cache()
+		{
+			static std::map<std::string, entry_map> instance;
+			return instance;
+		}
+
+		static entry_map read(const std::string& file)
+		{
+			entry_map entries;
+
+			std::ifstream stream(file);
+			std::string line;
+
+			// a file without the current version is stale; its entries are replaced as they are measured
+			if (!std::getline(stream, line) || line != header())
+				return entries;
+
+			while (std::getline(stream, line))
+			{
+				std::istringstream fields(line);
+
+				std::string scalar;
+				std::size_t minimum_size;
+				std::size_t bins;
+				fft_config config;
+
+				if (!(fields >> scalar >> minimum_size >> bins >> config.size >> config.first_radix >> config.real_input))
+					continue;
+
+				if ((scalar != "float" && scalar != "double") || !contains(candidates(minimum_size), config))
+					continue;
+
+				entries[std::make_tuple(scalar, minimum_size, bins)] = config;
+			}
+
+			return entries;
+		}
+
+		// Writes a private temporary file and renames it over the old one, so readers never see a partial file
+		// and an existing file or link at the final path is replaced rather than written through.
+		// Wisdom is only an optimization, so failing to write it is not an error.
+		static void write(const std::string& file, const entry_map& entries)
+		{
+			create_parent_directories(file);
+
+			auto temporary = file + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+
+			{
+				std::ofstream stream(temporary, std::ios::trunc);
+				if (!stream)
+					return;
+
+				stream << header() << '\n';
+
+				for (const auto& entry : entries)
+				{
+					stream << std::get<0>(entry.first) << ' ' << std::get<1>(entry.first) << ' ' << std::get<2>(entry.first) << ' '
+						<< entry.second.size << ' ' << entry.second.first_radix << ' ' << entry.second.real_input << '\n';
+				}
+
+				if (!stream.flush())
+				{
+					stream.close();
+					std::remove(temporary.c_str());
+					return;
+				}
+			}
+
+#if defined(_WIN32)
+			// rename does not replace an existing file on Windows
+			std::remove(file.c_str());
+#endif
+
+			if (std::rename(temporary.c_str(), file.c_str()) != 0)
+				std::remove(temporary.c_str());
+		}
+
+		// ~/.cache and the like need not exist yet. Errors are left for the file open to report.
+		static void create_parent_directories(const std::string& file)
+		{
+#if defined(_WIN32)
+			const char* separators = "/\\";
+#else
+			const char* separators = "/";
+#endif
+
+			for (auto position = file.find_first_of(separators, 1); position != std::string::npos; position = file.find_first_of(separators, position + 1))
+			{
+				auto directory = file.substr(0, position);
+
+#if defined(_WIN32)
+				if (directory.back() != ':')
+					_mkdir(directory.c_str());
+#else
+				mkdir(directory.c_str(), 0700);
+#endif
+			}
+		}
+
+		static std::string header()
+		{
+			return "vv_fft_wisdom " + std::to_string(version);
+		}
+
+		static bool contains(const std::vector<fft_config>& configs, const fft_config& config)
+		{
+			return std::any_of(configs.begin(), configs.end(), [&](const fft_config& c)
+			{
+				return c.size == config.size && c.first_radix == config.first_radix && c.real_input == config.real_input;
+			});
+		}
+
+	};
+
+	// Machine-specific choice of the NSDF forward transform, measured once and persisted with fft_wisdom_store.
+	template <class T>
+	class fft_wisdom
+	{
+	public:
+
+		// Fastest known configuration for transforms of minimum_size points of which bins low bins are kept.
+		// Measures and saves it when the wisdom file has no entry yet.
+		static fft_config plan(std::size_t minimum_size, std::size_t bins, const std::string& file = fft_wisdom_store::path())
+		{
+			auto key = std::make_tuple(std::string(scalar_name<T>::get()), minimum_size, bins);
+
+			return fft_wisdom_store::find_or_measure(file, key, [&]() { return measure(minimum_size, bins); });
+		}
+
+		static fft_config measure(std::size_t minimum_size, std::size_t bins)
+		{
+			auto candidates = fft_wisdom_store::candidates(minimum_size);
+
+			fft_config best = candidates.front();
+			double best_time = std::numeric_limits<double>::max();
+
+			for (const auto& config : candidates)
+			{
+				auto time = benchmark(config, bins);
+
+				if (time < best_time)
+				{
+					best = config;
+					best_time = time;
+				}
+			}
+
+			return best;
+		}
+
+	private:
+
+		// Best time of one forward transform of a real frame, keeping bins low bins, in seconds.
+		static double benchmark(const fft_config& config, std::size_t bins)
+		{
+			kissfft<T> fft(config.real_input ? config.size / 2 : config.size, false, config.first_radix);
+
+			std::vector<T> real(config.size);
+			std::vector<std::complex<T>> a(config.size);
+			std::vector<std::complex<T>> b(config.size);
+
+			for (std::size_t i = 0; i < config.size; ++i)
+			{
+				real[i] = static_cast<T>(std::sin(static_cast<double>(i) * 0.1));
+				a[i] = std::complex<T>(real[i], 0);
+			}
+
+			bins = std::min(std::max<std::size_t>(bins, 1), config.size);
+
+			const std::size_t rounds = 5;
+			const std::size_t iterations = 8;
+
+			auto best = std::numeric_limits<double>::max();
+
+			for (std::size_t round = 0; round <= rounds; ++round)
+			{
+				auto begin = std::chrono::steady_clock::now();
+
+				for (std::size_t i = 0; i < iterations; ++i)
+				{
+					if (config.real_input)
+						fft.transform_real(real.data(), b.data());
+					else
+						fft.transform_pruned(a.data(), b.data(), bins);
+				}
+
+				auto end = std::chrono::steady_clock::now();
+
+				// round 0 warms up caches
+				if (round != 0)
+					best = std::min(best, std::chrono::duration<double>(end - begin).count() / static_cast<double>(iterations));
+			}
+
+			return best;
+		}
+
+	};
+
+}
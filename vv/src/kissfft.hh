@@ -20,8 +20,11 @@ class kissfft
 
         using cpx_t = std::complex<scalar_t>;
 
+        /// @param first_radix Radix tried first when factorizing @c nfft:
+        /// 4 (factor out 4's, then 2's, then odd factors) or 2 (2's only).
         kissfft( const std::size_t nfft,
-                 const bool inverse )
+                 const bool inverse,
+                 const std::size_t first_radix = 4 )
             :_nfft(nfft)
             ,_inverse(inverse)
         {
@@ -32,9 +35,9 @@ class kissfft
                 _twiddles[i] = exp( cpx_t(0,i*phinc) );
 
             //factorize
-            //start factoring out 4's, then 2's, then 3,5,7,9,...
+            //start factoring out 4's (unless first_radix is 2), then 2's, then 3,5,7,9,...
             std::size_t n= _nfft;
-            std::size_t p=4;
+            std::size_t p=first_radix == 2 ? 2 : 4;
             do {
                 while (n % p) {
                     switch (p) {
@@ -122,6 +125,77 @@ class kissfft
             }
         }
 
+        /// Like transform(), but only @c fft_out[0] to @c fft_out[nout-1]
+        /// are computed; the rest of @c fft_out is left unspecified.
+        ///
+        /// Stages whose sub-transforms are longer than @c nout only combine
+        /// the first @c nout outputs of each sub-transform, so the
+        /// butterflies feeding discarded bins are skipped. Once a
+        /// sub-transform is short enough that all of its outputs are needed,
+        /// the regular butterflies take over.
+        void transform_pruned(const cpx_t * fft_in, cpx_t * fft_out, const std::size_t nout, const std::size_t stage = 0, const std::size_t fstride = 1) const
+        {
+            const std::size_t p = _stageRadix[stage];
+            const std::size_t m = _stageRemainder[stage];
+
+            if (nout > m) {
+                transform(fft_in, fft_out, stage, fstride);
+                return;
+            }
+
+            for (std::size_t q1=0; q1<p; ++q1) {
+                if (m==1)
+                    fft_out[q1] = fft_in[q1*fstride];
+                else
+                    transform_pruned(fft_in + q1*fstride, fft_out + q1*m, nout, stage+1, fstride*p);
+            }
+
+            // only the q=0 output of each butterfly is needed:
+            // X[u] = sum over q1 of W^(u*q1*fstride) * F_q1[u]
+            for (std::size_t u=0; u<nout; ++u) {
+                cpx_t sum = fft_out[u];
+                std::size_t twidx = 0;
+                for (std::size_t q1=1; q1<p; ++q1) {
+                    twidx += fstride * u;
+                    if (twidx>=_nfft)
+                        twidx-=_nfft;
+                    sum += fft_out[u + q1*m] * _twiddles[twidx];
+                }
+                fft_out[u] = sum;
+            }
+        }
+
+        /// Real-valued DFT of a real, Hermitian-symmetric spectrum whose
+        /// only non-zero bins are @c src[0] to @c src[nin-1] and their
+        /// mirrors @c src[N-k] == src[k], evaluated at outputs 0 to
+        /// @c nout-1 only.
+        ///
+        /// This is an input- and output-pruned transform: it costs
+        /// O(nin * nout) instead of O(N log N), which pays off when the band
+        /// and the range of outputs are both small. The result does not
+        /// depend on the direction of the plan. The same scaling as in
+        /// @c transform() applies.
+        void transform_hermitian_band( const scalar_t * src, const std::size_t nin,
+                                       scalar_t * dst, const std::size_t nout ) const
+        {
+            const scalar_t dc = nin != 0 ? src[0] : scalar_t(0);
+            for (std::size_t t=0; t<nout; ++t)
+                dst[t] = dc;
+
+            // bins in the outer loop keep one accumulator per output,
+            // so the inner loop has no dependency chain through a sum
+            for (std::size_t k=1; k<nin; ++k) {
+                const scalar_t a = scalar_t(2) * src[k];
+                const std::size_t step = k % _nfft;
+                std::size_t twidx = 0;
+                for (std::size_t t=0; t<nout; ++t) {
+                    dst[t] += a * _twiddles[twidx].real();
+                    twidx += step;
+                    twidx -= twidx>=_nfft ? _nfft : 0;
+                }
+            }
+        }
+
         /// Calculates the Discrete Fourier Transform (DFT) of a real input
         /// of size @c 2*N.
         ///
@@ -0,0 +1,205 @@
+#pragma once
+#include "fft_wisdom.hpp"
+#include "pitch_detector.hpp"
+#include "plan_cache.hpp"
+#include "utility.hpp"
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace vv
+{
+
+	// Normalized square difference function computed through an FFT autocorrelation.
+	// Picks the first NSDF peak above 0.9 times the highest one.
+	template <class T>
+	class nsdf_detector : public pitch_detector<T>
+	{
+	public:
+
+		nsdf_detector(double sampleRate, std::size_t frame_size, const fft_config& fft)
+			: sampleRate_(sampleRate)
+			, frame_size_(frame_size)
+			, fft_size_(std::max(fft.size, frame_size + frame_size / 2))
+			, fft_(plan_cache<T>::fft(fft_size_, false, fft.first_radix))
+			, half_(fft.real_input && fft_size_ % 2 == 0 ? plan_cache<T>::fft(fft_size_ / 2, false, fft.first_radix) : nullptr)
+			, window_(plan_cache<T>::hann_window(frame_size))
+			, range_(search_range(sampleRate, frame_size / 2 - 2))
+			, lags_(range_.maximum + 2)
+			, head_end_(std::min(lags_ + 1, frame_size))
+			, tail_begin_(std::max(head_end_, frame_size - lags_))
+			, cutoff_index_(band_bins(sampleRate, frame_size, fft_size_) - 1)
+			, v2_(half_ ? 0 : fft_size_)
+			, real_(half_ ? fft_size_ : 0)
+			, v3_(fft_size_)
+			, v4_(fft_size_ / 2)
+			, v5_(lags_)
+			, v7_(lags_)
+			, prefix_(frame_size + 1)
+		{
+		}
+
+		// Number of low bins, DC included, that the low-pass keeps.
+		static std::size_t band_bins(double sampleRate, std::size_t frame_size, std::size_t fft_size)
+		{
+			// The low-pass has always been applied as 800 Hz in frame_size bins; keep that frequency for any transform size.
+			auto cutoff_hz = 800.0 * static_cast<double>(frame_size) / static_cast<double>(frame_size + frame_size / 2);
+			auto cutoff_index = static_cast<std::size_t>(std::round(cutoff_hz * static_cast<double>(fft_size) / sampleRate));
+
+			return std::min(cutoff_index, fft_size / 2 - 1) + 1;
+		}
+
+		pitch_mark detect(const T* input) override
+		{
+			// Only bins 1..cutoff_index_ survive the low-pass, and the input is real, so their mirrors
+			// carry the same power. Both transforms skip everything outside that band and the searched lags.
+			if (half_)
+			{
+				prepare(input, real_.data());
+				half_->transform_real(real_.data(), v3_.data());
+			}
+			else
+			{
+				prepare(input, v2_.data());
+				fft_->transform_pruned(v2_.data(), v3_.data(), cutoff_index_ + 1);
+			}
+
+			v4_[0] = 0;
+
+			for (std::size_t i = 1; i <= cutoff_index_; ++i)
+				v4_[i] = std::norm(v3_[i]);
+
+			fft_->transform_hermitian_band(v4_.data(), cutoff_index_ + 1, v5_.data(), lags_);
+
+			// m(tau) = sum of x[i]^2 over [1, N - tau) plus sum of x[i]^2 over [tau, N - 1),
+			// which is P[N - tau] - P[1] + P[N - 1] - P[tau] in terms of the energy prefix sums.
+			const auto p = prefix_.data();
+			const auto ends = p[frame_size_ - 1] - p[1];
+			const auto scale = static_cast<T>(2) / static_cast<T>(fft_size_);
+
+			for (std::size_t i = 0; i < lags_; ++i)
+			{
+				auto m = (p[frame_size_ - i] - p[i]) + ends;
+
+				if (m < std::numeric_limits<T>::min())
+					v7_[i] = 0;
+				else
+					v7_[i] = scale * v5_[i] / m;
+			}
+
+			T maximum_value = 0;
+
+			for (std::size_t i = range_.minimum; i < range_.maximum; ++i)
+			{
+				auto p1 = v7_[i - 1];
+				auto p2 = v7_[i];
+				auto p3 = v7_[i + 1];
+
+				if (p1 < p2 && p2 > p3 && p2 > maximum_value)
+					maximum_value = p2;
+			}
+
+			pitch_mark mark;
+
+			for (std::size_t i = range_.minimum; i < range_.maximum; ++i)
+			{
+				auto p1 = v7_[i - 1];
+				auto p2 = v7_[i];
+				auto p3 = v7_[i + 1];
+
+				if (p1 < p2 && p2 > p3 && p2 > maximum_value * static_cast<T>(0.9))
+				{
+					mark.period = static_cast<std::uint32_t>(i);
+					mark.confidence = static_cast<float>(p2);
+					break;
+				}
+			}
+
+			return mark;
+		}
+
+	private:
+
+		// Windows the frame into the FFT input x (real or complex) and builds the energy prefix sums
+		// P[k] = sum of x[i]^2 over [0, k) in a single pass. Only the ends of P are read (below head_end_ and
+		// from tail_begin_), so the middle of the frame is a lane-wise reduction that vectorizes instead of a serial scan.
+		template <class X>
+		void prepare(const T* input, X* x)
+		{
+			const auto& window = *window_;
+			auto p = prefix_.data();
+
+			T sum = 0;
+			std::size_t i = 0;
+
+			p[0] = 0;
+
+			for (; i < head_end_; ++i)
+			{
+				auto w = input[i] * window[i];
+				x[i] = X(w);
+				sum += w * w;
+				p[i + 1] = sum;
+			}
+
+			T lane[difference_lanes] = {};
+
+			for (; i + difference_lanes <= tail_begin_; i += difference_lanes)
+			{
+				for (std::size_t k = 0; k < difference_lanes; ++k)
+				{
+					auto w = input[i + k] * window[i + k];
+					x[i + k] = X(w);
+					lane[k] += w * w;
+				}
+			}
+
+			for (; i < tail_begin_; ++i)
+			{
+				auto w = input[i] * window[i];
+				x[i] = X(w);
+				lane[0] += w * w;
+			}
+
+			for (std::size_t k = 0; k < difference_lanes; ++k)
+				sum += lane[k];
+
+			p[tail_begin_] = sum;
+
+			for (; i < frame_size_; ++i)
+			{
+				auto w = input[i] * window[i];
+				x[i] = X(w);
+				sum += w * w;
+				p[i + 1] = sum;
+			}
+		}
+
+		double sampleRate_;
+		std::size_t frame_size_;
+		std::size_t fft_size_;
+
+		// half_ is set when the real frame is packed into a half-size transform; fft_ is still needed for the band inverse
+		std::shared_ptr<const kissfft<T>> fft_;
+		std::shared_ptr<const kissfft<T>> half_;
+		std::shared_ptr<const std::vector<T>> window_;
+
+		period_range range_;
+		std::size_t lags_;
+		std::size_t head_end_;
+		std::size_t tail_begin_;
+		std::size_t cutoff_index_;
+
+		std::vector<std::complex<T>> v2_;
+		std::vector<T> real_;
+		std::vector<std::complex<T>> v3_;
+		std::vector<T> v4_;
+		std::vector<T> v5_;
+		std::vector<T> v7_;
+		std::vector<T> prefix_;
+
+	};
+
+}
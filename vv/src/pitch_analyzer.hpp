@@ -0,0 +1,69 @@
+#pragma once
+#include "pitch_index.hpp"
+#include "processor.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace vv
+{
+
+	// First pass of two-pass rendering: detects the pitch of a whole input and writes it to an index,
+	// one mark per stream frame. A stream given that index (stream::set_pitch_index) then renders the same input
+	// without running detection. Input is taken in chunks of any size, from the first sample the stream will see.
+	template <class T>
+	class pitch_analyzer
+	{
+	public:
+
+		static const std::size_t frame_size = processor<T>::buffer_size;
+
+		pitch_analyzer(double sampleRate, const fft_config& fft, const std::string& path, detector_type detector = detector_type::nsdf)
+			: processor_(sampleRate, fft)
+			, writer_(path, sampleRate, frame_size)
+		{
+			processor_.set_detector(detector);
+			frame_.reserve(frame_size);
+		}
+
+		void push(const T* input, std::size_t count)
+		{
+			while (count != 0)
+			{
+				auto size = std::min(count, frame_size - frame_.size());
+
+				frame_.insert(frame_.end(), input, input + size);
+				input += size;
+				count -= size;
+
+				if (frame_.size() == frame_size)
+				{
+					writer_.push(processor_.analyze(frame_.data()));
+					frame_.clear();
+				}
+			}
+		}
+
+		// Analyzes the last partial frame padded with silence, as a stream renders it when flushed, and finishes the file.
+		void close()
+		{
+			if (!frame_.empty())
+			{
+				frame_.resize(frame_size, 0);
+				writer_.push(processor_.analyze(frame_.data()));
+				frame_.clear();
+			}
+
+			writer_.close();
+		}
+
+	private:
+
+		processor<T> processor_;
+		pitch_index_writer writer_;
+		std::vector<T> frame_;
+
+	};
+
+}
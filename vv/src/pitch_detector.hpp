@@ -0,0 +1,92 @@
+#pragma once
+#include "pitch_mark.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace vv
+{
+
+	enum class detector_type
+	{
+		nsdf,
+		yin,
+		amdf,
+	};
+
+	static const std::size_t detector_type_count = 3;
+
+	// Estimates the period of one frame of T samples. Implementations keep their own scratch buffers,
+	// so an instance must not be shared between threads.
+	template <class T>
+	class pitch_detector
+	{
+	public:
+
+		virtual ~pitch_detector()
+		{
+		}
+
+		virtual pitch_mark detect(const T* input) = 0;
+
+	};
+
+	// Lags searched for the fundamental (50-300 Hz), clamped to [1, limit].
+	struct period_range
+	{
+		std::size_t minimum;
+		std::size_t maximum;
+	};
+
+	inline period_range search_range(double sampleRate, std::size_t limit)
+	{
+		auto minimum_hz = 50.0;
+		auto maximum_hz = 300.0;
+
+		auto minimum_index = static_cast<std::size_t>(std::round(sampleRate / maximum_hz));
+		auto maximum_index = static_cast<std::size_t>(std::round(sampleRate / minimum_hz));
+
+		minimum_index = std::max<std::size_t>(minimum_index, 1);
+		minimum_index = std::min<std::size_t>(minimum_index, limit);
+
+		maximum_index = std::max<std::size_t>(maximum_index, 1);
+		maximum_index = std::min<std::size_t>(maximum_index, limit);
+
+		return period_range{ minimum_index, maximum_index };
+	}
+
+	// Lags are processed in blocks of this many, staged in a local array, so compilers emit SIMD
+	// for the difference loops without alias checks or reassociating sums.
+	static const std::size_t difference_lanes = 8;
+
+	inline std::size_t round_up_to_lanes(std::size_t n)
+	{
+		return (n + difference_lanes - 1) / difference_lanes * difference_lanes;
+	}
+
+	// d[tau] = sum of f(x[j] - x[j + tau]) over j in [0, window_size), for tau in [0, lags).
+	// lags must be a multiple of difference_lanes.
+	template <class T, class F>
+	void accumulate_differences(const T* x, std::size_t window_size, T* d, std::size_t lags, F f)
+	{
+		std::fill(d, d + lags, T(0));
+
+		for (std::size_t j = 0; j < window_size; ++j)
+		{
+			auto x0 = x[j];
+			auto y = x + j;
+
+			for (std::size_t tau = 0; tau < lags; tau += difference_lanes)
+			{
+				T lane[difference_lanes];
+
+				for (std::size_t k = 0; k < difference_lanes; ++k)
+					lane[k] = f(x0 - y[tau + k]);
+
+				for (std::size_t k = 0; k < difference_lanes; ++k)
+					d[tau + k] += lane[k];
+			}
+		}
+	}
+
+}
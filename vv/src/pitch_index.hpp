@@ -0,0 +1,147 @@
+#pragma once
+#include "pitch_mark.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace vv
+{
+
+	// On-disk layout: header followed by one pitch_mark per frame.
+	struct pitch_index_header
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t frame_size;
+		std::uint32_t frame_count;
+		double sample_rate;
+	};
+
+	static const char pitch_index_magic[4] = { 'V', 'V', 'P', 'I' };
+	static const std::uint32_t pitch_index_version = 1;
+
+	class pitch_index_writer
+	{
+	public:
+
+		pitch_index_writer(const std::string& path, double sample_rate, std::size_t frame_size)
+			: stream_(path, std::ios::binary | std::ios::trunc)
+		{
+			if (!stream_)
+				throw std::runtime_error("cannot open pitch index for writing: " + path);
+
+			std::memcpy(header_.magic, pitch_index_magic, sizeof(header_.magic));
+			header_.version = pitch_index_version;
+			header_.frame_size = static_cast<std::uint32_t>(frame_size);
+			header_.frame_count = 0;
+			header_.sample_rate = sample_rate;
+
+			write_header();
+		}
+
+		pitch_index_writer(const pitch_index_writer&) = delete;
+		pitch_index_writer& operator =(const pitch_index_writer&) = delete;
+
+		~pitch_index_writer()
+		{
+			if (stream_.is_open())
+				write_header();
+		}
+
+		void push(const pitch_mark& mark)
+		{
+			stream_.write(reinterpret_cast<const char*>(&mark), sizeof(mark));
+			++header_.frame_count;
+		}
+
+		void close()
+		{
+			write_header();
+			stream_.close();
+
+			if (!stream_)
+				throw std::runtime_error("failed to write pitch index");
+		}
+
+	private:
+
+		void write_header()
+		{
+			auto position = stream_.tellp();
+
+			stream_.seekp(0);
+			stream_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+
+			if (position > static_cast<std::streamoff>(sizeof(header_)))
+				stream_.seekp(position);
+		}
+
+		std::ofstream stream_;
+		pitch_index_header header_;
+
+	};
+
+	// Read-only, memory-mapped view of an index written by pitch_index_writer.
+	class pitch_index
+	{
+	public:
+
+		explicit pitch_index(const std::string& path)
+			: file_(path.c_str(), boost::interprocess::read_only)
+			, region_(file_, boost::interprocess::read_only)
+		{
+			if (region_.get_size() < sizeof(pitch_index_header))
+				throw std::runtime_error("pitch index is truncated: " + path);
+
+			std::memcpy(&header_, region_.get_address(), sizeof(header_));
+
+			if (std::memcmp(header_.magic, pitch_index_magic, sizeof(header_.magic)) != 0 || header_.version != pitch_index_version)
+				throw std::runtime_error("not a pitch index: " + path);
+
+			// compare counts rather than byte sizes, which can wrap with a 32-bit size_t
+			if (header_.frame_count > (region_.get_size() - sizeof(pitch_index_header)) / sizeof(pitch_mark))
+				throw std::runtime_error("pitch index is truncated: " + path);
+
+			marks_ = reinterpret_cast<const pitch_mark*>(static_cast<const char*>(region_.get_address()) + sizeof(pitch_index_header));
+		}
+
+		double sample_rate() const
+		{
+			return header_.sample_rate;
+		}
+
+		std::size_t frame_size() const
+		{
+			return header_.frame_size;
+		}
+
+		std::size_t size() const
+		{
+			return header_.frame_count;
+		}
+
+		const pitch_mark& operator [](std::size_t index) const
+		{
+			return marks_[index];
+		}
+
+		const pitch_mark* data() const
+		{
+			return marks_;
+		}
+
+	private:
+
+		boost::interprocess::file_mapping file_;
+		boost::interprocess::mapped_region region_;
+		pitch_index_header header_;
+		const pitch_mark* marks_ = nullptr;
+
+	};
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+namespace vv
+{
+
+	// Result of pitch analysis for one frame. A period of 0 means no pitch was found.
+	struct pitch_mark
+	{
+		std::uint32_t period = 0;
+		float confidence = 0.0f;
+	};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "kissfft.hh"
+#include <boost/math/constants/constants.hpp>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace vv
+{
+
+	// Process-wide cache of immutable FFT plans and window tables.
+	// Entries are shared between processor instances and released when the last user goes away.
+	template <class T>
+	class plan_cache
+	{
+	public:
+
+		using fft_type = kissfft<T>;
+		using window_type = std::vector<T>;
+
+		static std::shared_ptr<const fft_type> fft(std::size_t size, bool inverse, std::size_t first_radix = 4)
+		{
+			static std::map<std::tuple<std::size_t, bool, std::size_t>, std::weak_ptr<const fft_type>> entries;
+
+			return acquire(entries, std::make_tuple(size, inverse, first_radix), [&]()
+			{
+				return std::make_shared<const fft_type>(size, inverse, first_radix);
+			});
+		}
+
+		static std::shared_ptr<const window_type> hann_window(std::size_t size)
+		{
+			static std::map<std::size_t, std::weak_ptr<const window_type>> entries;
+
+			return acquire(entries, size, [&]()
+			{
+				auto window = std::make_shared<window_type>(size);
+
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					auto r = static_cast<double>(i) / static_cast<double>(size);
+					(*window)[i] = static_cast<T>(0.5 - 0.5 * std::cos(boost::math::constants::two_pi<double>() * r));
+				}
+
+				return std::shared_ptr<const window_type>(std::move(window));
+			});
+		}
+
+	private:
+
+		static std::mutex& mutex()
+		{
+			static std::mutex instance;
+			return instance;
+		}
+
+		template <class Key, class Value, class Factory>
+		static std::shared_ptr<const Value> acquire(std::map<Key, std::weak_ptr<const Value>>& entries, const Key& key, Factory factory)
+		{
+			std::lock_guard<std::mutex> lock(mutex());
+
+			for (auto it = entries.begin(); it != entries.end();)
+			{
+				if (it->second.expired())
+					it = entries.erase(it);
+				else
+					++it;
+			}
+
+			auto& entry = entries[key];
+
+			if (auto value = entry.lock())
+				return value;
+
+			std::shared_ptr<const Value> value = factory();
+			entry = value;
+
+			return value;
+		}
+
+	};
+
+}
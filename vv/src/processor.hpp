@@ -1,136 +1,134 @@
 #pragma once
-#include "kissfft.hh"
+#include "amdf_detector.hpp"
+#include "fft_wisdom.hpp"
+#include "nsdf_detector.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+#include "yin_detector.hpp"
 #include <boost/math/constants/constants.hpp>
 #include <boost/optional.hpp>
+#include <array>
 #include <cstddef>
+#include <memory>
+#include <string>
 
 namespace vv
 {
 
-	template <class T, class U>
-	auto lerp(T x0, T x1, U ratio)
-	{
-		return x0 + (x1 - x0) * ratio;
-	}
-
-	template <class T>
-	auto invlerp(T x0, T x1, T x)
-	{
-		return (x - x0) / (x1 - x0);
-	}
-
+	// Pitch and formant shifter for frames of T samples. All per-sample arithmetic is done in T.
 	template <class T>
-	auto squared(T x)
-	{
-		return x * x;
-	}
-
 	class processor
 	{
 	public:
 
+		using sample_type = T;
+
 		static const std::size_t buffer_size = 4096;
 		static const std::size_t nsdf_size = buffer_size / 2;
 
+		// Smallest transform that holds a frame plus the NSDF lags without circular aliasing.
+		static const std::size_t minimum_fft_size = buffer_size + nsdf_size;
+
 		explicit processor(double sampleRate)
-			: sampleRate_(sampleRate)
-			, v1_(buffer_size)
-			, v2_(buffer_size + nsdf_size)
-			, v3_(buffer_size + nsdf_size)
-			, v4_(buffer_size + nsdf_size)
-			, v5_(buffer_size + nsdf_size)
-			, v6_(buffer_size)
-			, v7_(buffer_size / 2)
+			: processor(sampleRate, default_fft())
 		{
 		}
 
-		void operator ()(const float* input, float* output, double pitch_shift, double formant_shift)
+		// NSDF transform configuration used without measuring.
+		static fft_config default_fft()
 		{
-			for (std::size_t i = 0; i < buffer_size; ++i)
-				v1_[i] = std::complex<float>(input[i], 0.0f);
-
-			for (std::size_t i = 0; i < buffer_size; ++i)
-			{
-				auto r = static_cast<double>(i) / static_cast<double>(buffer_size);
-				auto w = 0.5 - 0.5 * std::cos(boost::math::constants::two_pi<double>() * r);
-				v2_[i] = v1_[i] * static_cast<float>(w);
-			}
-
-			fft_.transform(v2_.data(), v3_.data());
+			return fft_config{ minimum_fft_size, 4 };
+		}
 
-			auto cutoff_hz = 800.0;
-			auto cutoff_index = static_cast<std::size_t>(std::round(cutoff_hz * static_cast<double>(buffer_size) / sampleRate_));
+		// NSDF transform configuration for this machine and sample rate, measured on first use and kept in the wisdom file.
+		static fft_config plan_fft(double sampleRate, const std::string& wisdom = fft_wisdom_store::path())
+		{
+			return fft_wisdom<T>::plan(minimum_fft_size, nsdf_detector<T>::band_bins(sampleRate, buffer_size, minimum_fft_size), wisdom);
+		}
 
-			for (std::size_t i = 0; i < cutoff_index; ++i)
-			{
-				v4_[i + 1] = std::norm(v3_[i + 1]);
-				v4_[buffer_size - i - 1] = std::norm(v3_[buffer_size - i - 1]);
-			}
+		processor(double sampleRate, const fft_config& fft)
+			: sampleRate_(sampleRate)
+		{
+			detectors_[static_cast<std::size_t>(detector_type::nsdf)] = std::make_unique<nsdf_detector<T>>(sampleRate, buffer_size, fft);
+			detectors_[static_cast<std::size_t>(detector_type::yin)] = std::make_unique<yin_detector<T>>(sampleRate, buffer_size);
+			detectors_[static_cast<std::size_t>(detector_type::amdf)] = std::make_unique<amdf_detector<T>>(sampleRate, buffer_size);
+		}
 
-			ifft_.transform(v4_.data(), v5_.data());
+		void operator ()(const T* input, T* output, double pitch_shift, double formant_shift)
+		{
+			(*this)(input, output, pitch_shift, formant_shift, analyze(input));
+		}
 
-			for (std::size_t i = 0; i < buffer_size + nsdf_size; ++i)
-				v5_[i] /= static_cast<float>(buffer_size + nsdf_size);
+		// Synthesis only, from a mark produced by analyze(), possibly in an earlier pass (see pitch_analyzer).
+		void operator ()(const T* input, T* output, double pitch_shift, double formant_shift, const pitch_mark& mark)
+		{
+			render(input, output, carry(mark), pitch_shift, formant_shift);
+		}
 
-			for (std::size_t i = 1; i < buffer_size; ++i)
-			{
-				auto j = buffer_size - i - 1;
-				v6_[j] = v6_[j + 1] + squared(v2_[i].real()) + squared(v2_[j].real());
-			}
+		// Skips detection and uses the given fundamental frequency (e.g. from an upstream tracker) as the period.
+		void operator ()(const T* input, T* output, double pitch_shift, double formant_shift, double input_hz)
+		{
+			render(input, output, carry(input_hz), pitch_shift, formant_shift);
+		}
 
-			for (std::size_t i = 0; i < buffer_size / 2; ++i)
-			{
-				if (v6_[i] < std::numeric_limits<double>::min())
-					v7_[i] = 0.0f;
-				else
-					v7_[i] = 2.0f * v5_[i].real() / v6_[i];
-			}
+		// Period to synthesize the next frame with. A frame without a detected pitch reuses the previous period;
+		// that is the only state carried from one frame to the next, so frames must be carried in order.
+		boost::optional<std::size_t> carry(const pitch_mark& mark)
+		{
+			boost::optional<std::size_t> peak_index;
 
-			auto minimum_hz = 50.0;
-			auto maximum_hz = 300.0;
+			if (mark.period != 0)
+				peak_index = std::min<std::size_t>(mark.period, buffer_size);
 
-			auto minimum_index = static_cast<std::size_t>(std::round(sampleRate_ / maximum_hz));
-			auto maximum_index = static_cast<std::size_t>(std::round(sampleRate_ / minimum_hz));
+			if (!peak_index && last_peak_index_)
+				peak_index = last_peak_index_;
 
-			minimum_index = std::max<std::size_t>(minimum_index, 1);
-			minimum_index = std::min<std::size_t>(minimum_index, buffer_size / 2 - 2);
+			last_peak_index_ = peak_index;
 
-			maximum_index = std::max<std::size_t>(maximum_index, 1);
-			maximum_index = std::min<std::size_t>(maximum_index, buffer_size / 2 - 2);
+			return peak_index;
+		}
 
-			double maximum_value = 0.0;
+		boost::optional<std::size_t> carry(double input_hz)
+		{
+			boost::optional<std::size_t> peak_index;
 
-			for (std::size_t i = minimum_index; i < maximum_index; ++i)
+			if (input_hz > 0.0)
 			{
-				auto p1 = v7_[i - 1];
-				auto p2 = v7_[i];
-				auto p3 = v7_[i + 1];
-
-				if (p1 < p2 && p2 > p3 && p2 > maximum_value)
-					maximum_value = p2;
+				// clamped while still a double: a tiny input_hz gives a period no size_t can hold
+				auto period = std::min(std::max(std::round(sampleRate_ / input_hz), 1.0), static_cast<double>(buffer_size));
+				peak_index = static_cast<std::size_t>(period);
 			}
 
-			boost::optional<std::size_t> peak_index;
-			double peak_value = 0.0;
+			last_peak_index_ = peak_index;
 
-			for (std::size_t i = minimum_index; i < maximum_index; ++i)
-			{
-				auto p1 = v7_[i - 1];
-				auto p2 = v7_[i];
-				auto p3 = v7_[i + 1];
+			return peak_index;
+		}
 
-				if (p1 < p2 && p2 > p3 && p2 > maximum_value * 0.9)
-				{
-					peak_index = i;
-					peak_value = p2;
-					break;
-				}
-			}
+		// Runs the pitch detection stages on one frame without touching the synthesis state.
+		pitch_mark analyze(const T* input)
+		{
+			trace_scope scope(trace_, "analyze", trace_category::stage);
+			return detectors_[static_cast<std::size_t>(detector_)]->detect(input);
+		}
 
-			if (!peak_index && last_peak_index_)
-				peak_index = last_peak_index_;
+		// All backends are built up front, so switching is safe on the audio thread.
+		void set_detector(detector_type type)
+		{
+			detector_ = type;
+		}
 
-			last_peak_index_ = peak_index;
+		// Stage timings and passthrough fallbacks are recorded to ring (which must outlive the processor), or nowhere when null.
+		void set_trace(trace_ring* ring)
+		{
+			trace_ = ring;
+		}
+
+		// Synthesis of one frame with a period from carry(). Returns false when the frame was passed through unshifted.
+		// Touches no processor state, so frames can be rendered concurrently when no trace is attached.
+		// Frame layout is planned in double; the per-sample overlap loop runs entirely in T.
+		bool render(const T* input, T* output, boost::optional<std::size_t> peak_index, double pitch_shift, double formant_shift_value) const
+		{
+			trace_scope scope(trace_, "synthesize", trace_category::stage);
 
 			bool enable = false;
 
@@ -139,21 +137,23 @@ namespace vv
 				std::size_t last_dst = 0;
 				std::size_t last_src1 = 0;
 				std::size_t last_src2 = 0;
-				double last_src_ratio = 0.0;
+				T last_src_ratio = 0;
 
-				auto easing = [&](double x)
+				auto formant_shift = static_cast<T>(formant_shift_value);
+
+				auto easing = [&](T x)
 				{
-					return (1.0 - std::cos(boost::math::constants::pi<double>() * x)) / 2.0;
+					return (1 - std::cos(boost::math::constants::pi<T>() * x)) / 2;
 				};
 
-				auto interpolate = [&](double x1, double x2, double ratio)
+				auto interpolate = [&](T x1, T x2, T ratio)
 				{
 					return lerp(x1, x2, easing(ratio));
 				};
 
-				auto get_value = [&](double indexf) -> double
+				auto get_value = [&](T indexf) -> T
 				{
-					if (indexf < 0.0)
+					if (indexf < 0)
 						return input[0];
 
 					auto index = static_cast<std::size_t>(std::floor(indexf));
@@ -165,21 +165,21 @@ namespace vv
 					return interpolate(input[index], input[index + 1], ratio);
 				};
 
-				auto overlap = [&](std::size_t dst, std::size_t src1, std::size_t src2, double src_ratio)
+				auto overlap = [&](std::size_t dst, std::size_t src1, std::size_t src2, T src_ratio)
 				{
 					for (std::size_t i = last_dst; i < dst; ++i)
 					{
-						auto ratio = static_cast<double>(i - last_dst) / static_cast<double>(dst - last_dst);
+						auto ratio = static_cast<T>(i - last_dst) / static_cast<T>(dst - last_dst);
 
-						auto p1_1 = get_value(static_cast<double>(last_src1) + static_cast<double>(i - last_dst) * formant_shift);
-						auto p1_2 = get_value(static_cast<double>(last_src2) + static_cast<double>(i - last_dst) * formant_shift);
+						auto p1_1 = get_value(static_cast<T>(last_src1) + static_cast<T>(i - last_dst) * formant_shift);
+						auto p1_2 = get_value(static_cast<T>(last_src2) + static_cast<T>(i - last_dst) * formant_shift);
 						auto p1 = interpolate(p1_1, p1_2, last_src_ratio);
 
-						auto p2_1 = get_value(static_cast<double>(src1) - static_cast<double>(dst - i) * formant_shift);
-						auto p2_2 = get_value(static_cast<double>(src2) - static_cast<double>(dst - i) * formant_shift);
+						auto p2_1 = get_value(static_cast<T>(src1) - static_cast<T>(dst - i) * formant_shift);
+						auto p2_2 = get_value(static_cast<T>(src2) - static_cast<T>(dst - i) * formant_shift);
 						auto p2 = interpolate(p2_1, p2_2, src_ratio);
 
-						output[i] = static_cast<float>(interpolate(p1, p2, ratio));
+						output[i] = interpolate(p1, p2, ratio);
 					}
 
 					last_dst = dst;
@@ -212,42 +212,52 @@ namespace vv
 
 						if (frame_index == q)
 						{
-							overlap(dst, src, src, 0.0);
+							overlap(dst, src, src, 0);
 						}
 						else
 						{
-							auto src_ratio = frame_indexf - std::floor(frame_indexf);
+							auto src_ratio = static_cast<T>(frame_indexf - std::floor(frame_indexf));
 							overlap(dst, src, src + *peak_index, src_ratio);
 						}
 					}
 
-					overlap(buffer_size, buffer_size, buffer_size, 0.0);
+					overlap(buffer_size, buffer_size, buffer_size, 0);
 
 					enable = true;
 				}
 			}
 
 			if (!enable)
+			{
+				if (trace_)
+					trace_->push("passthrough", trace_category::passthrough, trace_now(), 0, peak_index ? static_cast<double>(*peak_index) : 0.0);
+
 				std::copy(input, input + buffer_size, output);
+			}
+
+			return enable;
 		}
 
 	private:
 
 		double sampleRate_;
 
-		kissfft<float> fft_{ buffer_size + nsdf_size, false };
-		kissfft<float> ifft_{ buffer_size + nsdf_size, true };
-
-		std::vector<std::complex<float>> v1_;
-		std::vector<std::complex<float>> v2_;
-		std::vector<std::complex<float>> v3_;
-		std::vector<std::complex<float>> v4_;
-		std::vector<std::complex<float>> v5_;
-		std::vector<float> v6_;
-		std::vector<float> v7_;
+		std::array<std::unique_ptr<pitch_detector<T>>, detector_type_count> detectors_;
+		detector_type detector_ = detector_type::nsdf;
 
 		boost::optional<std::size_t> last_peak_index_;
 
+		trace_ring* trace_ = nullptr;
+
 	};
 
+	template <class T>
+	const std::size_t processor<T>::buffer_size;
+
+	template <class T>
+	const std::size_t processor<T>::nsdf_size;
+
+	template <class T>
+	const std::size_t processor<T>::minimum_fft_size;
+
 }
@@ -0,0 +1,265 @@
+#pragma once
+#include "pitch_index.hpp"
+#include "processor.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <boost/circular_buffer.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace vv
+{
+
+	// Parameters for one frame, taken when the frame's input is complete.
+	struct frame_settings
+	{
+		double pitch_shift = 1.0;
+		double formant_shift = 1.0;
+
+		// > 0 skips detection and uses this fundamental frequency
+		double input_hz = 0.0;
+	};
+
+	// Adapts processor to host blocks of any length. Output lags input by latency() samples.
+	//
+	// With batch_frames > 1, that many frames (at most max_batch_frames) are collected and rendered together:
+	// detection and synthesis run in parallel on the pool, and only the carried period is resolved in order in between.
+	// The rendered audio is the same as with one frame per batch, just later.
+	template <class T>
+	class stream
+	{
+	public:
+
+		using processor_type = processor<T>;
+
+		static const std::size_t frame_size = processor_type::buffer_size;
+
+		// Bounds latency and per-instance memory; more threads than this mostly add latency.
+		static const std::size_t max_batch_frames = 8;
+
+		stream(double sampleRate, const fft_config& fft, std::size_t batch_frames = 1, thread_pool* pool = nullptr)
+			: sampleRate_(sampleRate)
+			, frames_(pool ? std::min(std::max<std::size_t>(batch_frames, 1), max_batch_frames) : 1)
+			, pool_(pool)
+			, in_buffer_(frames_ * frame_size)
+			, out_buffer_(frames_ * frame_size)
+			, temp_input_(frames_ * frame_size)
+			, temp_output_(frames_ * frame_size)
+			, settings_(frames_)
+			, marks_(frames_)
+			, peaks_(frames_)
+			, shifted_(frames_)
+		{
+			// one processor per frame slot, since detectors keep scratch buffers
+			for (std::size_t i = 0; i < frames_; ++i)
+				processors_.push_back(std::make_unique<processor_type>(sampleRate, fft));
+
+			for (std::size_t i = 0; i < frames_ * frame_size; ++i)
+				in_buffer_.push_back(0);
+		}
+
+		std::size_t latency() const
+		{
+			return frames_ * frame_size;
+		}
+
+		std::size_t batch_frames() const
+		{
+			return frames_;
+		}
+
+		void set_detector(detector_type type)
+		{
+			for (auto& p : processors_)
+				p->set_detector(type);
+		}
+
+		// The ring is single-producer, so in batched mode only the calling thread records, per batch instead of per frame.
+		void set_trace(trace_ring* ring)
+		{
+			trace_ = ring;
+
+			if (frames_ == 1)
+				processors_.front()->set_trace(ring);
+		}
+
+		// Frames covered by marks take their period from it instead of running detection, in batched mode too.
+		// marks[f] belongs to input samples [f * frame_size, (f + 1) * frame_size) counted from the first sample
+		// passed to process(), which is how pitch_analyzer writes an index. Null marks detection for every frame again.
+		// Call between process() calls; the next frame continues from the current input position.
+		void set_pitch_marks(std::shared_ptr<const pitch_mark> marks, std::size_t count)
+		{
+			index_ = std::move(marks);
+			index_size_ = index_ ? count : 0;
+		}
+
+		// Same, with the marks of an index written by pitch_analyzer. Throws if it was analyzed at another sample rate.
+		void set_pitch_index(std::shared_ptr<const pitch_index> index)
+		{
+			if (!index)
+			{
+				set_pitch_marks(nullptr, 0);
+				return;
+			}
+
+			if (index->sample_rate() != sampleRate_ || index->frame_size() != frame_size)
+				throw std::invalid_argument("pitch index does not match the stream configuration");
+
+			// the marks share ownership of the mapping
+			set_pitch_marks(std::shared_ptr<const pitch_mark>(index, index->data()), index->size());
+		}
+
+		// Reads and writes count samples. settings() is called once per completed frame, in order.
+		template <class F>
+		void process(const T* in, T* out, std::size_t count, F settings)
+		{
+			std::size_t remain = count;
+
+			while (remain != 0)
+			{
+				for (auto completed = in_buffer_.size() / frame_size; captured_ < completed; ++captured_)
+					settings_[captured_] = settings();
+
+				if (in_buffer_.full())
+				{
+					std::copy(in_buffer_.begin(), in_buffer_.end(), temp_input_.begin());
+
+					render_batch();
+
+					out_buffer_.assign(temp_output_.begin(), temp_output_.end());
+					in_buffer_.clear();
+					captured_ = 0;
+					rendered_ += frames_;
+				}
+
+				auto size = std::min(frame_size - in_buffer_.size() % frame_size, remain);
+
+				std::copy(in, in + size, std::back_inserter(in_buffer_));
+				std::copy(out_buffer_.begin(), out_buffer_.begin() + size, out);
+
+				out_buffer_.rresize(out_buffer_.size() - size);
+
+				in += size;
+				out += size;
+				remain -= size;
+			}
+		}
+
+	private:
+
+		void render_batch()
+		{
+			auto& carrier = *processors_.front();
+
+			if (frames_ == 1)
+			{
+				const auto& s = settings_.front();
+
+				trace_scope frame(trace_, "frame", trace_category::frame);
+
+				if (s.input_hz > 0.0)
+					carrier(temp_input_.data(), temp_output_.data(), s.pitch_shift, s.formant_shift, s.input_hz);
+				else if (auto mark = indexed_mark(0))
+					carrier(temp_input_.data(), temp_output_.data(), s.pitch_shift, s.formant_shift, *mark);
+				else
+					carrier(temp_input_.data(), temp_output_.data(), s.pitch_shift, s.formant_shift);
+
+				return;
+			}
+
+			trace_scope batch(trace_, "batch", trace_category::frame, static_cast<double>(frames_));
+
+			{
+				trace_scope scope(trace_, "analyze", trace_category::stage, static_cast<double>(frames_));
+
+				pool_->parallel_for(frames_, [&](std::size_t i)
+				{
+					if (settings_[i].input_hz > 0.0)
+						return;
+
+					if (auto mark = indexed_mark(i))
+						marks_[i] = *mark;
+					else
+						marks_[i] = processors_[i]->analyze(temp_input_.data() + i * frame_size);
+				});
+			}
+
+			for (std::size_t i = 0; i < frames_; ++i)
+			{
+				if (settings_[i].input_hz > 0.0)
+					peaks_[i] = carrier.carry(settings_[i].input_hz);
+				else
+					peaks_[i] = carrier.carry(marks_[i]);
+			}
+
+			{
+				trace_scope scope(trace_, "synthesize", trace_category::stage, static_cast<double>(frames_));
+
+				pool_->parallel_for(frames_, [&](std::size_t i)
+				{
+					const auto& s = settings_[i];
+					shifted_[i] = processors_[i]->render(temp_input_.data() + i * frame_size, temp_output_.data() + i * frame_size, peaks_[i], s.pitch_shift, s.formant_shift);
+				});
+			}
+
+			if (trace_)
+			{
+				for (std::size_t i = 0; i < frames_; ++i)
+				{
+					if (!shifted_[i])
+						trace_->push("passthrough", trace_category::passthrough, trace_now(), 0, peaks_[i] ? static_cast<double>(*peaks_[i]) : 0.0);
+				}
+			}
+		}
+
+		// Mark for a slot of the batch being rendered, or null when it must be detected.
+		// The first batch is the silence that makes up the latency and has no input frame.
+		const pitch_mark* indexed_mark(std::size_t slot) const
+		{
+			auto frame = rendered_ + slot;
+
+			if (frame < frames_ || frame - frames_ >= index_size_)
+				return nullptr;
+
+			return index_.get() + (frame - frames_);
+		}
+
+		double sampleRate_;
+		std::size_t frames_;
+		thread_pool* pool_;
+		trace_ring* trace_ = nullptr;
+
+		std::vector<std::unique_ptr<processor_type>> processors_;
+
+		boost::circular_buffer<T> in_buffer_;
+		boost::circular_buffer<T> out_buffer_;
+		std::vector<T> temp_input_;
+		std::vector<T> temp_output_;
+
+		// per frame slot of the current batch
+		std::vector<frame_settings> settings_;
+		std::vector<pitch_mark> marks_;
+		std::vector<boost::optional<std::size_t>> peaks_;
+		std::vector<char> shifted_;
+		std::size_t captured_ = 0;
+
+		// frames rendered so far, including the initial silence
+		std::size_t rendered_ = 0;
+
+		std::shared_ptr<const pitch_mark> index_;
+		std::size_t index_size_ = 0;
+
+	};
+
+	template <class T>
+	const std::size_t stream<T>::frame_size;
+
+	template <class T>
+	const std::size_t stream<T>::max_batch_frames;
+
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vv
+{
+
+	// Fixed set of worker threads for fork-join loops. The calling thread takes part in every loop,
+	// and items are claimed one at a time from a shared counter, so a worker that finishes early
+	// keeps taking items off the others instead of idling.
+	// One loop runs on the workers at a time; a caller that finds them busy runs its items itself.
+	class thread_pool
+	{
+	public:
+
+		// One worker per hardware thread besides the caller.
+		static std::size_t default_workers()
+		{
+			auto threads = std::thread::hardware_concurrency();
+			return threads > 1 ? threads - 1 : 0;
+		}
+
+		// Pool with the default number of workers, shared by everything in the process that uses it
+		// and released when the last user goes away, so many plugin instances do not each start a full set of threads.
+		static std::shared_ptr<thread_pool> shared()
+		{
+			static std::mutex mutex;
+			static std::weak_ptr<thread_pool> entry;
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (auto pool = entry.lock())
+				return pool;
+
+			auto pool = std::make_shared<thread_pool>();
+			entry = pool;
+
+			return pool;
+		}
+
+		explicit thread_pool(std::size_t workers = default_workers())
+		{
+			workers_.reserve(workers);
+
+			// threads already started must be joined before the exception leaves, or ~thread terminates
+			try
+			{
+				for (std::size_t i = 0; i < workers; ++i)
+					workers_.emplace_back([this]() { work(); });
+			}
+			catch (...)
+			{
+				stop();
+				throw;
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator =(const thread_pool&) = delete;
+
+		~thread_pool()
+		{
+			stop();
+		}
+
+		// Number of threads that run a loop, including the caller.
+		std::size_t concurrency() const
+		{
+			return workers_.size() + 1;
+		}
+
+		// Calls f(i) for every i in [0, count) and returns when all calls have finished.
+		// f must not throw, and must not call parallel_for on the same pool.
+		template <class F>
+		void parallel_for(std::size_t count, F f)
+		{
+			if (count == 0)
+				return;
+
+			std::unique_lock<std::mutex> loop(loop_mutex_, std::defer_lock);
+
+			if (workers_.empty() || count == 1 || !loop.try_lock())
+			{
+				for (std::size_t i = 0; i < count; ++i)
+					f(i);
+
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+
+				invoke_ = [](void* context, std::size_t i) { (*static_cast<F*>(context))(i); };
+				context_ = &f;
+				count_ = count;
+				next_.store(0, std::memory_order_relaxed);
+				busy_ = workers_.size();
+				++generation_;
+			}
+
+			wake_.notify_all();
+			run_items();
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			done_.wait(lock, [&]() { return busy_ == 0; });
+		}
+
+	private:
+
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+
+			wake_.notify_all();
+
+			for (auto& worker : workers_)
+				worker.join();
+		}
+
+		void work()
+		{
+			std::uint64_t seen = 0;
+
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+
+					if (stop_)
+						return;
+
+					seen = generation_;
+				}
+
+				run_items();
+
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+
+					if (--busy_ == 0)
+						done_.notify_one();
+				}
+			}
+		}
+
+		void run_items()
+		{
+			for (;;)
+			{
+				auto i = next_.fetch_add(1, std::memory_order_relaxed);
+				if (i >= count_)
+					break;
+
+				invoke_(context_, i);
+			}
+		}
+
+		std::vector<std::thread> workers_;
+
+		// held by the caller whose loop the workers are running
+		std::mutex loop_mutex_;
+
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::condition_variable done_;
+
+		// current loop; written under mutex_ before workers are woken
+		void (*invoke_)(void*, std::size_t) = nullptr;
+		void* context_ = nullptr;
+		std::size_t count_ = 0;
+		std::atomic<std::size_t> next_{ 0 };
+
+		std::size_t busy_ = 0;
+		std::uint64_t generation_ = 0;
+		bool stop_ = false;
+
+	};
+
+}
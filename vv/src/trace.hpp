@@ -0,0 +1,368 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vv
+{
+
+	enum class trace_category : std::uint8_t
+	{
+		process,
+		frame,
+		stage,
+		parameter,
+		passthrough,
+	};
+
+	// Names must be string literals (or otherwise outlive the ring), so recording never copies strings.
+	struct trace_event
+	{
+		const char* name = "";
+		trace_category category = trace_category::process;
+		std::int64_t begin_ns = 0;
+		std::int64_t duration_ns = 0;
+		double value = 0.0;
+	};
+
+	inline std::int64_t trace_now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Single-producer, single-consumer event ring. The audio thread pushes, any other thread drains.
+	// All storage is allocated up front; when the ring is full, new events are dropped and counted.
+	class trace_ring
+	{
+	public:
+
+		// capacity is rounded up to a power of two
+		explicit trace_ring(std::size_t capacity = 4096)
+			: events_(round_up(capacity))
+			, mask_(events_.size() - 1)
+		{
+		}
+
+		trace_ring(const trace_ring&) = delete;
+		trace_ring& operator =(const trace_ring&) = delete;
+
+		// Producer side. Wait-free and allocation-free.
+		bool push(const trace_event& event) noexcept
+		{
+			auto head = head_.load(std::memory_order_relaxed);
+
+			if (head - tail_.load(std::memory_order_acquire) == events_.size())
+			{
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			events_[head & mask_] = event;
+			head_.store(head + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		void push(const char* name, trace_category category, std::int64_t begin_ns, std::int64_t duration_ns = 0, double value = 0.0) noexcept
+		{
+			trace_event event;
+			event.name = name;
+			event.category = category;
+			event.begin_ns = begin_ns;
+			event.duration_ns = duration_ns;
+			event.value = value;
+
+			push(event);
+		}
+
+		// Consumer side. Hands every event recorded so far to f, oldest first, and returns how many there were.
+		template <class F>
+		std::size_t drain(F f)
+		{
+			auto tail = tail_.load(std::memory_order_relaxed);
+			auto head = head_.load(std::memory_order_acquire);
+
+			for (auto i = tail; i != head; ++i)
+				f(static_cast<const trace_event&>(events_[i & mask_]));
+
+			tail_.store(head, std::memory_order_release);
+
+			return static_cast<std::size_t>(head - tail);
+		}
+
+		std::uint64_t dropped() const
+		{
+			return dropped_.load(std::memory_order_relaxed);
+		}
+
+	private:
+
+		static std::size_t round_up(std::size_t n)
+		{
+			std::size_t result = 1;
+
+			while (result < n)
+				result *= 2;
+
+			return result;
+		}
+
+		std::vector<trace_event> events_;
+		std::size_t mask_;
+
+		// padded apart so producer and consumer do not contend for a cache line
+		// (padding rather than alignas, which C++14 operator new does not honour)
+		char padding0_[64];
+		std::atomic<std::uint64_t> head_{ 0 };
+		char padding1_[64 - sizeof(std::atomic<std::uint64_t>)];
+		std::atomic<std::uint64_t> tail_{ 0 };
+		char padding2_[64 - sizeof(std::atomic<std::uint64_t>)];
+		std::atomic<std::uint64_t> dropped_{ 0 };
+
+	};
+
+	// Records the lifetime of the scope as one event. Does nothing when ring is null.
+	class trace_scope
+	{
+	public:
+
+		trace_scope(trace_ring* ring, const char* name, trace_category category, double value = 0.0)
+			: ring_(ring)
+			, name_(name)
+			, category_(category)
+			, value_(value)
+			, begin_ns_(ring ? trace_now() : 0)
+		{
+		}
+
+		trace_scope(const trace_scope&) = delete;
+		trace_scope& operator =(const trace_scope&) = delete;
+
+		~trace_scope()
+		{
+			if (ring_)
+				ring_->push(name_, category_, begin_ns_, trace_now() - begin_ns_, value_);
+		}
+
+	private:
+
+		trace_ring* ring_;
+		const char* name_;
+		trace_category category_;
+		double value_;
+		std::int64_t begin_ns_;
+
+	};
+
+	// Writes drained events in the Chrome trace event format, which chrome://tracing and Perfetto load directly.
+	// Durations become complete ("X") events, parameters become counters and passthrough fallbacks instant events.
+	class chrome_trace_writer
+	{
+	public:
+
+		explicit chrome_trace_writer(std::ostream& stream)
+			: stream_(stream)
+		{
+			stream_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		}
+
+		chrome_trace_writer(const chrome_trace_writer&) = delete;
+		chrome_trace_writer& operator =(const chrome_trace_writer&) = delete;
+
+		~chrome_trace_writer()
+		{
+			if (!closed_)
+				close();
+		}
+
+		// Labels the track of one plugin instance.
+		void process_name(int pid, const char* name)
+		{
+			begin_event();
+			stream_ << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":";
+			write_string(name);
+			stream_ << "}}";
+		}
+
+		void write(int pid, const trace_event& event)
+		{
+			begin_event();
+			stream_ << "{\"name\":";
+			write_string(event.name);
+			stream_ << ",\"cat\":\"" << category_name(event.category) << "\",\"pid\":" << pid << ",\"tid\":0,\"ts\":";
+			write_microseconds(event.begin_ns);
+
+			switch (event.category)
+			{
+			case trace_category::parameter:
+				stream_ << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+				break;
+			case trace_category::passthrough:
+				stream_ << ",\"ph\":\"i\",\"s\":\"p\",\"args\":{\"value\":" << event.value << "}}";
+				break;
+			default:
+				stream_ << ",\"ph\":\"X\",\"dur\":";
+				write_microseconds(event.duration_ns);
+				stream_ << ",\"args\":{\"value\":" << event.value << "}}";
+				break;
+			}
+		}
+
+		void close()
+		{
+			stream_ << "]}\n";
+			closed_ = true;
+		}
+
+	private:
+
+		static const char* category_name(trace_category category)
+		{
+			switch (category)
+			{
+			case trace_category::process:
+				return "process";
+			case trace_category::frame:
+				return "frame";
+			case trace_category::stage:
+				return "stage";
+			case trace_category::parameter:
+				return "parameter";
+			case trace_category::passthrough:
+				return "passthrough";
+			}
+
+			return "";
+		}
+
+		void begin_event()
+		{
+			if (!first_)
+				stream_ << ',';
+
+			stream_ << '\n';
+			first_ = false;
+		}
+
+		void write_string(const char* s)
+		{
+			stream_ << '"';
+
+			for (; *s; ++s)
+			{
+				if (*s == '"' || *s == '\\')
+					stream_ << '\\';
+
+				stream_ << *s;
+			}
+
+			stream_ << '"';
+		}
+
+		// the format wants microseconds; keep nanosecond precision as three decimals
+		void write_microseconds(std::int64_t ns)
+		{
+			if (ns < 0)
+			{
+				stream_ << '-';
+				ns = -ns;
+			}
+
+			auto fraction = ns % 1000;
+
+			stream_ << ns / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+		}
+
+		std::ostream& stream_;
+		bool first_ = true;
+		bool closed_ = false;
+
+	};
+
+	// Drains a ring into a Chrome trace file from its own thread, so a plugin can record inside a host that never drains it.
+	// The file is complete once the recorder is destroyed. The ring must outlive the recorder and have no other consumer.
+	class trace_recorder
+	{
+	public:
+
+		// Returns null when the file cannot be created.
+		static std::unique_ptr<trace_recorder> open(trace_ring& ring, const std::string& path, const char* name)
+		{
+			std::unique_ptr<trace_recorder> result(new trace_recorder(ring, path));
+
+			if (!result->file_)
+				return nullptr;
+
+			result->writer_.process_name(0, name);
+			result->thread_ = std::thread([recorder = result.get()]() { recorder->run(); });
+
+			return result;
+		}
+
+		trace_recorder(const trace_recorder&) = delete;
+		trace_recorder& operator =(const trace_recorder&) = delete;
+
+		~trace_recorder()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+
+			wake_.notify_one();
+
+			if (thread_.joinable())
+				thread_.join();
+
+			drain();
+			writer_.close();
+		}
+
+	private:
+
+		trace_recorder(trace_ring& ring, const std::string& path)
+			: ring_(ring)
+			, file_(path, std::ios::trunc)
+			, writer_(file_)
+		{
+		}
+
+		// often enough that the default ring does not overflow at any sensible block size
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+
+			while (!wake_.wait_for(lock, std::chrono::milliseconds(10), [&]() { return stop_; }))
+			{
+				lock.unlock();
+				drain();
+				lock.lock();
+			}
+		}
+
+		void drain()
+		{
+			ring_.drain([&](const trace_event& event) { writer_.write(0, event); });
+		}
+
+		trace_ring& ring_;
+		std::ofstream file_;
+		chrome_trace_writer writer_;
+
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		bool stop_ = false;
+		std::thread thread_;
+
+	};
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+namespace vv
+{
+
+	template <class T, class U>
+	auto lerp(T x0, T x1, U ratio)
+	{
+		return x0 + (x1 - x0) * ratio;
+	}
+
+	template <class T>
+	auto invlerp(T x0, T x1, T x)
+	{
+		return (x - x0) / (x1 - x0);
+	}
+
+	template <class T>
+	auto squared(T x)
+	{
+		return x * x;
+	}
+
+}
@@ -1,5 +1,9 @@
 #include <public.sdk/source/common/pluginview.cpp>
+#if defined(_WIN32)
 #include <public.sdk/source/main/dllmain.cpp>
+#else
+#include <public.sdk/source/main/linuxmain.cpp>
+#endif
 #include <public.sdk/source/main/pluginfactoryvst3.cpp>
 #include <public.sdk/source/vst3stdsdk.cpp>
 #include <public.sdk/source/vst/vstinitiids.cpp>
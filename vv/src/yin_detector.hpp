@@ -0,0 +1,72 @@
+#pragma once
+#include "difference_detector.hpp"
+#include "utility.hpp"
+#include <cstdint>
+
+namespace vv
+{
+
+	// YIN: cumulative-mean-normalized squared difference, first dip below an absolute threshold.
+	// Cheaper than the NSDF for the default search range and needs no FFT plans.
+	template <class T>
+	class yin_detector : public difference_detector<T>
+	{
+	public:
+
+		yin_detector(double sampleRate, std::size_t frame_size)
+			: difference_detector<T>(sampleRate, frame_size)
+		{
+		}
+
+		pitch_mark detect(const T* input) override
+		{
+			auto d = this->differences(input, [](T v)
+			{
+				return squared(v);
+			});
+
+			// d'(tau) = d(tau) * tau / sum(d(1..tau)), d'(0) = 1
+			T sum = 0;
+			d[0] = 1;
+
+			for (std::size_t tau = 1; tau < lags_; ++tau)
+			{
+				sum += d[tau];
+				d[tau] = sum > 0 ? d[tau] * static_cast<T>(tau) / sum : T(1);
+			}
+
+			const T threshold = static_cast<T>(0.2);
+
+			std::size_t best = range_.minimum;
+
+			for (std::size_t tau = range_.minimum; tau < range_.maximum; ++tau)
+			{
+				if (d[tau] < threshold)
+				{
+					best = this->deepest(d, tau, [&](T v) { return v < threshold; });
+					break;
+				}
+
+				if (d[tau] < d[best])
+					best = tau;
+			}
+
+			pitch_mark mark;
+
+			if (best < range_.maximum && d[best] < 1)
+			{
+				mark.period = static_cast<std::uint32_t>(best);
+				mark.confidence = static_cast<float>(1 - d[best]);
+			}
+
+			return mark;
+		}
+
+	private:
+
+		using difference_detector<T>::range_;
+		using difference_detector<T>::lags_;
+
+	};
+
+}
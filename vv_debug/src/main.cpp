@@ -1,22 +1,176 @@
+#include <pitch_analyzer.hpp>
 #include <processor.hpp>
+#include <stream.hpp>
+#include <thread_pool.hpp>
 #include <boost/math/constants/constants.hpp>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+namespace
+{
+
+	// Runs every pitch detector over noisy harmonic tones with known f0 and prints time per frame and accuracy.
+	void compare_detectors(double sample_rate)
+	{
+		const char* names[] = { "nsdf", "yin", "amdf" };
+
+		std::mt19937 random(1);
+		std::normal_distribution<double> noise(0.0, 0.05);
+
+		std::vector<std::vector<float>> frames;
+		std::vector<double> periods;
+
+		for (double hz = 70.0; hz <= 290.0; hz += 7.3)
+		{
+			std::vector<float> frame(vv::processor<float>::buffer_size);
+			double phase = 0.0;
+
+			for (auto& sample : frame)
+			{
+				phase += hz / sample_rate;
+				phase -= std::floor(phase);
+
+				double v = 0.0;
+				for (int h = 1; h <= 12; ++h)
+					v += std::sin(boost::math::constants::two_pi<double>() * h * phase) / (0.5 * h * h + 1.0);
+
+				sample = static_cast<float>(0.3 * v + noise(random));
+			}
+
+			frames.push_back(frame);
+			periods.push_back(sample_rate / hz);
+		}
+
+		std::printf("%-6s %12s %8s %10s %14s\n", "", "us/frame", "gross", "unvoiced", "mean(cents)");
+
+		for (std::size_t type = 0; type < vv::detector_type_count; ++type)
+		{
+			vv::processor<float> p(sample_rate);
+			p.set_detector(static_cast<vv::detector_type>(type));
+
+			double time = 0.0;
+			double cents = 0.0;
+			std::size_t gross = 0;
+			std::size_t unvoiced = 0;
+
+			for (std::size_t i = 0; i < frames.size(); ++i)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				auto mark = p.analyze(frames[i].data());
+				auto end = std::chrono::steady_clock::now();
+
+				time += std::chrono::duration<double, std::micro>(end - begin).count();
+
+				if (mark.period == 0)
+				{
+					++unvoiced;
+					continue;
+				}
+
+				auto error = std::abs(1200.0 * std::log2(static_cast<double>(mark.period) / periods[i]));
+
+				if (error > 50.0)
+					++gross;
+				else
+					cents += error;
+			}
+
+			auto voiced = frames.size() - gross - unvoiced;
+
+			std::printf("%-6s %12.1f %8u %10u %14.1f\n", names[type], time / static_cast<double>(frames.size()),
+				static_cast<unsigned>(gross), static_cast<unsigned>(unvoiced), voiced != 0 ? cents / static_cast<double>(voiced) : 0.0);
+		}
+	}
+
+	// Two-pass rendering: analyzes a gliding tone into an index, then renders it through streams
+	// with and without the index and prints the largest difference, which should be 0.
+	void two_pass(double sample_rate)
+	{
+		const char* path = "vv_debug.vvpi";
+
+		std::vector<float> input(static_cast<std::size_t>(sample_rate * 3.3));
+		double phase = 0.0;
+
+		for (std::size_t i = 0; i < input.size(); ++i)
+		{
+			auto t = static_cast<double>(i) / sample_rate;
+			phase += (150.0 + 40.0 * std::sin(boost::math::constants::two_pi<double>() * 0.7 * t)) / sample_rate;
+			phase -= std::floor(phase);
+
+			input[i] = static_cast<float>(0.5 * std::sin(boost::math::constants::two_pi<double>() * phase)
+				+ 0.2 * std::sin(2.0 * boost::math::constants::two_pi<double>() * phase));
+		}
+
+		auto fft = vv::processor<float>::plan_fft(sample_rate);
+
+		{
+			vv::pitch_analyzer<float> analyzer(sample_rate, fft, path);
+
+			// uneven chunks, as a file reader would deliver them
+			for (std::size_t i = 0; i < input.size(); i += 1000)
+				analyzer.push(input.data() + i, std::min<std::size_t>(1000, input.size() - i));
+
+			analyzer.close();
+		}
+
+		auto index = std::make_shared<vv::pitch_index>(path);
+		auto pool = vv::thread_pool::shared();
+
+		for (std::size_t batch_frames : { 1, 4 })
+		{
+			std::vector<float> outputs[2];
+
+			for (int indexed = 0; indexed < 2; ++indexed)
+			{
+				vv::stream<float> s(sample_rate, fft, batch_frames, pool.get());
+
+				if (indexed)
+					s.set_pitch_index(index);
+
+				// flushing with latency() samples of silence renders the padded last frame
+				auto padded = input;
+				padded.resize(input.size() + s.latency(), 0.0f);
+
+				auto& output = outputs[indexed];
+				output.resize(padded.size());
+
+				s.process(padded.data(), output.data(), padded.size(), []() { return vv::frame_settings{ 1.3, 1.0, 0.0 }; });
+			}
+
+			float difference = 0.0f;
+
+			for (std::size_t i = 0; i < outputs[0].size(); ++i)
+				difference = std::max(difference, std::abs(outputs[0][i] - outputs[1][i]));
+
+			std::printf("two-pass, %u frame batches: %u marks, max difference %g\n",
+				static_cast<unsigned>(batch_frames), static_cast<unsigned>(index->size()), difference);
+		}
+	}
+
+}
 
 int main()
 {
-	vv::processor p(44100.0);
+	vv::processor<float> p(44100.0);
 
-	std::vector<float> input(vv::processor::buffer_size);
+	std::vector<float> input(vv::processor<float>::buffer_size);
 
-	for (std::size_t i = 0; i < vv::processor::buffer_size; ++i)
+	for (std::size_t i = 0; i < vv::processor<float>::buffer_size; ++i)
 	{
-		auto ratio = static_cast<double>(i) / static_cast<double>(vv::processor::buffer_size);
+		auto ratio = static_cast<double>(i) / static_cast<double>(vv::processor<float>::buffer_size);
 		auto v = std::sin(10.0 * ratio * boost::math::constants::two_pi<double>());
 
 		input[i] = static_cast<float>(v);
 	}
 
-	std::vector<float> output(vv::processor::buffer_size);
+	std::vector<float> output(vv::processor<float>::buffer_size);
 
 	p(input.data(), output.data(), 1.5, 1.2);
+
+	two_pass(44100.0);
+
+	compare_detectors(44100.0);
 }
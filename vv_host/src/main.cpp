@@ -0,0 +1,475 @@
+#include <audio_effect.hpp>
+#include <edit_controller.hpp>
+#include <pluginterfaces/base/ipluginbase.h>
+#include <pluginterfaces/vst/ivstaudioprocessor.h>
+#include <public.sdk/source/vst/hosting/parameterchanges.h>
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+	enum class automation
+	{
+		none,
+		per_block,
+		dense,
+		input_pitch,
+	};
+
+	const char* to_string(automation pattern)
+	{
+		switch (pattern)
+		{
+		case automation::none:
+			return "none";
+		case automation::per_block:
+			return "per_block";
+		case automation::dense:
+			return "dense";
+		case automation::input_pitch:
+			return "input_pitch";
+		}
+
+		return "";
+	}
+
+	struct statistics
+	{
+		std::size_t calls = 0;
+		double p50 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+		double total = 0.0;
+		double budget = 0.0;
+		double max_load = 0.0;
+		std::uint64_t dropped_events = 0;
+	};
+
+	// Host block size of a configuration; 0 draws a new size from [32, 4096] for every call.
+	const std::size_t random_block = 0;
+	const std::size_t max_block = 4096;
+
+	std::string block_name(std::size_t block_size)
+	{
+		return block_size == random_block ? "rand" : std::to_string(block_size);
+	}
+
+	// Empties the plugin's trace ring from its own thread while process() runs, like a host UI or logger would.
+	class trace_drainer
+	{
+	public:
+
+		trace_drainer(vv::trace_ring& ring, std::vector<vv::trace_event>& events)
+			: ring_(ring)
+			, events_(events)
+			, thread_([this]() { run(); })
+		{
+		}
+
+		~trace_drainer()
+		{
+			stop_ = true;
+			thread_.join();
+			drain();
+		}
+
+	private:
+
+		void run()
+		{
+			while (!stop_)
+			{
+				drain();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		void drain()
+		{
+			ring_.drain([&](const vv::trace_event& event) { events_.push_back(event); });
+		}
+
+		vv::trace_ring& ring_;
+		std::vector<vv::trace_event>& events_;
+		std::atomic<bool> stop_{ false };
+		std::thread thread_;
+
+	};
+
+	// budgets holds the real-time budget of each call, in the same order as durations.
+	statistics summarize(std::vector<double>& durations, const std::vector<double>& budgets)
+	{
+		statistics result;
+
+		if (durations.empty())
+			return result;
+
+		for (std::size_t i = 0; i < durations.size(); ++i)
+		{
+			result.budget += budgets[i];
+			result.max_load = std::max(result.max_load, durations[i] / budgets[i]);
+		}
+
+		result.budget /= static_cast<double>(durations.size());
+
+		std::sort(durations.begin(), durations.end());
+
+		auto percentile = [&](double p)
+		{
+			auto index = static_cast<std::size_t>(p * static_cast<double>(durations.size() - 1));
+			return durations[index];
+		};
+
+		result.calls = durations.size();
+		result.p50 = percentile(0.50);
+		result.p99 = percentile(0.99);
+		result.max = durations.back();
+
+		for (auto duration : durations)
+			result.total += duration;
+
+		return result;
+	}
+
+	// Sawtooth with vibrato, roughly the spectral shape of a sung vowel.
+	std::vector<float> make_input(double sample_rate, std::size_t size)
+	{
+		std::vector<float> input(size);
+
+		double phase = 0.0;
+
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			auto t = static_cast<double>(i) / sample_rate;
+			auto hz = 150.0 * std::pow(2.0, 0.05 * std::sin(boost::math::constants::two_pi<double>() * 5.0 * t));
+
+			phase += hz / sample_rate;
+			phase -= std::floor(phase);
+
+			input[i] = static_cast<float>(0.5 * (2.0 * phase - 1.0));
+		}
+
+		return input;
+	}
+
+	void add_points(Steinberg::Vst::ParameterChanges& changes, Steinberg::Vst::ParamID id, std::size_t position, std::size_t block_size, std::size_t interval, double sample_rate)
+	{
+		Steinberg::int32 queue_index;
+		auto queue = changes.addParameterData(id, queue_index);
+		if (!queue)
+			return;
+
+		for (std::size_t offset = 0; offset < block_size; offset += interval)
+		{
+			auto t = static_cast<double>(position + offset) / sample_rate;
+			auto value = 0.5 + 0.25 * std::sin(boost::math::constants::two_pi<double>() * 0.5 * t);
+
+			Steinberg::int32 point_index;
+			queue->addPoint(static_cast<Steinberg::int32>(offset), value, point_index);
+		}
+	}
+
+	void add_constant(Steinberg::Vst::ParameterChanges& changes, Steinberg::Vst::ParamID id, double value)
+	{
+		Steinberg::int32 queue_index;
+		auto queue = changes.addParameterData(id, queue_index);
+		if (!queue)
+			return;
+
+		Steinberg::int32 point_index;
+		queue->addPoint(0, value, point_index);
+	}
+
+	void set_channels(Steinberg::Vst::AudioBusBuffers& bus, Steinberg::Vst::Sample32** channels)
+	{
+		bus.channelBuffers32 = channels;
+	}
+
+	void set_channels(Steinberg::Vst::AudioBusBuffers& bus, Steinberg::Vst::Sample64** channels)
+	{
+		bus.channelBuffers64 = channels;
+	}
+
+	// T selects the host sample size: float for kSample32, double for kSample64.
+	template <class T>
+	bool run(Steinberg::IPluginFactory* factory, double sample_rate, const std::vector<float>& input, std::size_t block_size, automation pattern, statistics& result, std::vector<vv::trace_event>* events, Steinberg::int32 process_mode = Steinberg::Vst::kRealtime)
+	{
+		const Steinberg::int32 sample_size = sizeof(T) == sizeof(double) ? Steinberg::Vst::kSample64 : Steinberg::Vst::kSample32;
+
+		Steinberg::Vst::IComponent* component = nullptr;
+
+		if (factory->createInstance(vv::audio_effect_uid.toTUID(), Steinberg::Vst::IComponent::iid, reinterpret_cast<void**>(&component)) != Steinberg::kResultOk || !component)
+			return false;
+
+		Steinberg::FUnknownPtr<Steinberg::Vst::IAudioProcessor> processor(component);
+
+		if (!processor || component->initialize(nullptr) != Steinberg::kResultOk)
+		{
+			component->release();
+			return false;
+		}
+
+		if (processor->canProcessSampleSize(sample_size) != Steinberg::kResultTrue)
+		{
+			component->terminate();
+			component->release();
+			return false;
+		}
+
+		Steinberg::Vst::ProcessSetup setup;
+		setup.processMode = process_mode;
+		setup.symbolicSampleSize = sample_size;
+		setup.maxSamplesPerBlock = static_cast<Steinberg::int32>(block_size == random_block ? max_block : block_size);
+		setup.sampleRate = sample_rate;
+
+		// the plugin records only when someone drains it; null when it records to VV_TRACE_DIR on its own
+		auto effect = dynamic_cast<vv::audio_effect*>(component);
+		auto ring = events && effect ? effect->enable_trace() : nullptr;
+
+		if (processor->setupProcessing(setup) != Steinberg::kResultOk)
+		{
+			std::fprintf(stderr, "setupProcessing failed\n");
+			component->terminate();
+			component->release();
+			return false;
+		}
+
+		if (component->setActive(true) != Steinberg::kResultOk)
+		{
+			std::fprintf(stderr, "setActive failed\n");
+			component->terminate();
+			component->release();
+			return false;
+		}
+
+		processor->setProcessing(true);
+
+		std::vector<T> in_block(setup.maxSamplesPerBlock);
+		std::vector<T> out_block(setup.maxSamplesPerBlock);
+
+		T* in_channels[] = { in_block.data() };
+		T* out_channels[] = { out_block.data() };
+
+		Steinberg::Vst::AudioBusBuffers in_bus;
+		in_bus.numChannels = 1;
+		in_bus.silenceFlags = 0;
+		set_channels(in_bus, in_channels);
+
+		Steinberg::Vst::AudioBusBuffers out_bus;
+		out_bus.numChannels = 1;
+		out_bus.silenceFlags = 0;
+		set_channels(out_bus, out_channels);
+
+		Steinberg::Vst::ParameterChanges changes(2);
+
+		Steinberg::Vst::ProcessData data;
+		data.processMode = setup.processMode;
+		data.symbolicSampleSize = setup.symbolicSampleSize;
+		data.numInputs = 1;
+		data.numOutputs = 1;
+		data.inputs = &in_bus;
+		data.outputs = &out_bus;
+		data.inputParameterChanges = &changes;
+
+		std::vector<double> durations;
+		std::vector<double> budgets;
+
+		// fixed seed, so every configuration sees the same sequence of sizes
+		std::mt19937 random(1);
+		std::uniform_int_distribution<std::size_t> random_size(32, max_block);
+
+		std::unique_ptr<trace_drainer> drainer;
+
+		if (events && ring)
+			drainer = std::make_unique<trace_drainer>(*ring, *events);
+
+		bool ok = true;
+
+		for (std::size_t position = 0, size = 0; ; position += size)
+		{
+			size = block_size == random_block ? random_size(random) : block_size;
+
+			if (position + size > input.size())
+				break;
+
+			std::copy(input.begin() + position, input.begin() + position + size, in_block.begin());
+			data.numSamples = static_cast<Steinberg::int32>(size);
+
+			changes.clearQueue();
+
+			switch (pattern)
+			{
+			case automation::none:
+				break;
+			case automation::per_block:
+				add_points(changes, vv::edit_controller::pitch_tag, position, size, size, sample_rate);
+				break;
+			case automation::dense:
+				add_points(changes, vv::edit_controller::pitch_tag, position, size, 32, sample_rate);
+				add_points(changes, vv::edit_controller::formant_tag, position, size, 32, sample_rate);
+				break;
+			case automation::input_pitch:
+				add_points(changes, vv::edit_controller::pitch_tag, position, size, size, sample_rate);
+				add_constant(changes, vv::edit_controller::input_pitch_tag, 150.0 / vv::edit_controller::input_pitch_max_hz);
+				break;
+			}
+
+			auto begin = std::chrono::steady_clock::now();
+			auto processed = processor->process(data);
+			auto end = std::chrono::steady_clock::now();
+
+			// a rejected call returns at once, and its timing would pass for a fast one
+			if (processed != Steinberg::kResultOk)
+			{
+				std::fprintf(stderr, "process failed at sample %u\n", static_cast<unsigned>(position));
+				ok = false;
+				break;
+			}
+
+			durations.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+			budgets.push_back(1.0e6 * static_cast<double>(size) / sample_rate);
+		}
+
+		drainer.reset();
+
+		result = summarize(durations, budgets);
+
+		if (ring)
+			result.dropped_events = ring->dropped();
+
+		processor->setProcessing(false);
+		component->setActive(false);
+		component->terminate();
+		component->release();
+
+		return ok;
+	}
+
+}
+
+int main(int argc, char* argv[])
+{
+	auto seconds = argc > 1 ? std::atof(argv[1]) : 10.0;
+	auto sample_rate = argc > 2 ? std::atof(argv[2]) : 44100.0;
+	auto trace_path = argc > 3 ? argv[3] : nullptr;
+
+	auto factory = GetPluginFactory();
+	if (!factory)
+	{
+		std::fprintf(stderr, "GetPluginFactory failed\n");
+		return 1;
+	}
+
+	auto input = make_input(sample_rate, static_cast<std::size_t>(seconds * sample_rate));
+
+	// Powers of two, sizes that leave a remainder in every frame, and a size that changes with every call.
+	const std::size_t block_sizes[] = { 32, 64, 128, 256, 441, 512, 1000, 1024, 2048, 4096, random_block };
+	const automation patterns[] = { automation::none, automation::per_block, automation::dense, automation::input_pitch };
+	const unsigned sample_bits[] = { 32, 64 };
+
+	std::ofstream trace_stream;
+	std::unique_ptr<vv::chrome_trace_writer> trace_writer;
+
+	if (trace_path)
+	{
+		trace_stream.open(trace_path);
+		if (!trace_stream)
+		{
+			std::fprintf(stderr, "cannot open %s\n", trace_path);
+			return 1;
+		}
+
+		trace_writer = std::make_unique<vv::chrome_trace_writer>(trace_stream);
+	}
+
+	int trace_pid = 0;
+	int exit_code = 0;
+
+	std::printf("%4s %6s %-11s %8s %12s %10s %10s %10s %10s\n", "bits", "block", "automation", "calls", "budget(us)", "p50(us)", "p99(us)", "max(us)", "max/budget");
+
+	for (auto bits : sample_bits)
+	{
+		for (auto block_size : block_sizes)
+		{
+			for (auto pattern : patterns)
+			{
+				statistics result;
+				std::vector<vv::trace_event> events;
+				auto trace_events = trace_writer ? &events : nullptr;
+
+				auto ok = bits == 64
+					? run<double>(factory, sample_rate, input, block_size, pattern, result, trace_events)
+					: run<float>(factory, sample_rate, input, block_size, pattern, result, trace_events);
+
+				if (!ok)
+				{
+					std::printf("%4u %6s %-11s FAILED\n", bits, block_name(block_size).c_str(), to_string(pattern));
+					exit_code = 1;
+					continue;
+				}
+
+				// for random sizes the budget is the mean, and max/budget the worst call against its own budget
+				std::printf("%4u %6s %-11s %8u %12.1f %10.1f %10.1f %10.1f %10.3f\n",
+					bits, block_name(block_size).c_str(), to_string(pattern), static_cast<unsigned>(result.calls),
+					result.budget, result.p50, result.p99, result.max, result.max_load);
+
+				if (trace_writer)
+				{
+					// one track per configuration
+					++trace_pid;
+
+					auto name = std::to_string(bits) + "-bit block " + block_name(block_size) + " " + to_string(pattern);
+					trace_writer->process_name(trace_pid, name.c_str());
+
+					for (const auto& event : events)
+						trace_writer->write(trace_pid, event);
+
+					if (result.dropped_events != 0)
+						std::fprintf(stderr, "%s: %u trace events dropped\n", name.c_str(), static_cast<unsigned>(result.dropped_events));
+				}
+			}
+		}
+	}
+
+	// Whole-file render time, the number that matters for bounces. Offline mode renders batches of frames in parallel.
+	std::printf("\n%4s %-9s %12s %10s\n", "bits", "mode", "render(ms)", "speed(x)");
+
+	for (auto bits : sample_bits)
+	{
+		const Steinberg::int32 modes[] = { Steinberg::Vst::kRealtime, Steinberg::Vst::kOffline };
+
+		for (auto mode : modes)
+		{
+			statistics result;
+
+			auto ok = bits == 64
+				? run<double>(factory, sample_rate, input, 4096, automation::none, result, nullptr, mode)
+				: run<float>(factory, sample_rate, input, 4096, automation::none, result, nullptr, mode);
+
+			if (!ok)
+			{
+				std::printf("%4u %-9s FAILED\n", bits, mode == Steinberg::Vst::kOffline ? "offline" : "realtime");
+				exit_code = 1;
+				continue;
+			}
+
+			std::printf("%4u %-9s %12.1f %10.1f\n", bits, mode == Steinberg::Vst::kOffline ? "offline" : "realtime",
+				result.total / 1000.0, seconds * 1.0e6 / result.total);
+		}
+	}
+
+	factory->release();
+
+	return exit_code;
+}
@@ -0,0 +1 @@
+#include <public.sdk/source/vst/hosting/parameterchanges.cpp>
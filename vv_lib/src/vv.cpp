@@ -0,0 +1,378 @@
+#include "vv.h"
+#include <pitch_analyzer.hpp>
+#include <stream.hpp>
+#include <boost/circular_buffer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+	// Decouples input from output on top of vv::stream, which needs both in equal amounts per call.
+	template <class T>
+	class queue_stream
+	{
+	public:
+
+		queue_stream(double sampleRate, const vv::fft_config& fft, std::size_t batch_frames, vv::thread_pool* pool)
+			: stream_(sampleRate, fft, batch_frames, pool)
+			, staging_(vv::stream<T>::frame_size)
+			, output_(stream_.latency() + vv::stream<T>::frame_size)
+		{
+		}
+
+		vv::stream<T>& get_stream()
+		{
+			return stream_;
+		}
+
+		template <class F>
+		std::size_t push(const T* input, std::size_t count, F settings)
+		{
+			std::size_t done = 0;
+
+			for (;;)
+			{
+				auto size = std::min({ count - done, staging_.size(), output_.capacity() - output_.size() });
+				if (size == 0)
+					break;
+
+				stream_.process(input + done, staging_.data(), size, settings);
+				std::copy(staging_.begin(), staging_.begin() + size, std::back_inserter(output_));
+
+				done += size;
+			}
+
+			return done;
+		}
+
+		std::size_t pull(T* output, std::size_t count)
+		{
+			auto size = std::min(count, output_.size());
+
+			std::copy(output_.begin(), output_.begin() + size, output);
+			output_.erase_begin(size);
+
+			return size;
+		}
+
+		std::size_t available() const
+		{
+			return output_.size();
+		}
+
+	private:
+
+		vv::stream<T> stream_;
+		std::vector<T> staging_;
+		boost::circular_buffer<T> output_;
+
+	};
+
+	template <class T>
+	vv::fft_config plan_fft(const vv_config& config)
+	{
+		if (!config.fft_measure)
+			return vv::processor<T>::default_fft();
+
+		if (config.fft_wisdom_path)
+			return vv::processor<T>::plan_fft(config.sample_rate, config.fft_wisdom_path);
+
+		return vv::processor<T>::plan_fft(config.sample_rate);
+	}
+
+	template <class T>
+	std::unique_ptr<vv::pitch_analyzer<T>> make_analyzer(const vv_config& config, vv_detector detector, const char* path)
+	{
+		return std::make_unique<vv::pitch_analyzer<T>>(config.sample_rate, plan_fft<T>(config), path, static_cast<vv::detector_type>(detector));
+	}
+
+	// the range the plugin's parameters map to
+	const double minimum_ratio = 0.5;
+	const double maximum_ratio = 2.0;
+
+	bool is_positive(double value)
+	{
+		return std::isfinite(value) && value > 0.0;
+	}
+
+}
+
+struct vv_stream
+{
+	double sample_rate = 0.0;
+	vv_sample_format format = VV_FLOAT32;
+	vv::frame_settings settings;
+
+	// declared before the streams, which hold a pointer to it
+	std::unique_ptr<vv::thread_pool> pool;
+
+	std::unique_ptr<queue_stream<float>> f32;
+	std::unique_ptr<queue_stream<double>> f64;
+
+	template <class T>
+	std::size_t push(queue_stream<T>* target, const T* input, std::size_t count)
+	{
+		if (!target || (!input && count != 0))
+			return 0;
+
+		return target->push(input, count, [&]() { return settings; });
+	}
+
+	template <class T>
+	std::size_t pull(queue_stream<T>* target, T* output, std::size_t count)
+	{
+		if (!target || (!output && count != 0))
+			return 0;
+
+		return target->pull(output, count);
+	}
+};
+
+struct vv_analyzer
+{
+	std::unique_ptr<vv::pitch_analyzer<float>> f32;
+	std::unique_ptr<vv::pitch_analyzer<double>> f64;
+	bool finished = false;
+
+	template <class T>
+	vv_status push(vv::pitch_analyzer<T>* target, const T* input, std::size_t count)
+	{
+		if (!target || finished || (!input && count != 0))
+			return VV_INVALID_ARGUMENT;
+
+		target->push(input, count);
+		return VV_OK;
+	}
+};
+
+void vv_config_init(vv_config* config)
+{
+	if (!config)
+		return;
+
+	config->sample_rate = 44100.0;
+	config->format = VV_FLOAT32;
+	config->threads = 1;
+	config->fft_wisdom_path = nullptr;
+	config->fft_measure = 1;
+}
+
+vv_stream* vv_stream_create(const vv_config* config)
+{
+	if (!config || !is_positive(config->sample_rate) || (config->format != VV_FLOAT32 && config->format != VV_FLOAT64))
+		return nullptr;
+
+	try
+	{
+		auto result = std::make_unique<vv_stream>();
+		result->sample_rate = config->sample_rate;
+		result->format = config->format;
+
+		std::size_t batch_frames = 1;
+
+		if (config->threads > 1)
+		{
+			// threads beyond the batch cap would have nothing to do
+			auto threads = std::min<std::size_t>(config->threads, vv::stream<float>::max_batch_frames);
+
+			result->pool = std::make_unique<vv::thread_pool>(threads - 1);
+			batch_frames = result->pool->concurrency();
+		}
+
+		if (config->format == VV_FLOAT64)
+			result->f64 = std::make_unique<queue_stream<double>>(config->sample_rate, plan_fft<double>(*config), batch_frames, result->pool.get());
+		else
+			result->f32 = std::make_unique<queue_stream<float>>(config->sample_rate, plan_fft<float>(*config), batch_frames, result->pool.get());
+
+		return result.release();
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void vv_stream_destroy(vv_stream* stream)
+{
+	delete stream;
+}
+
+size_t vv_stream_latency(const vv_stream* stream)
+{
+	if (!stream)
+		return 0;
+
+	if (stream->f64)
+		return stream->f64->get_stream().latency();
+
+	return stream->f32->get_stream().latency();
+}
+
+size_t vv_stream_push_f32(vv_stream* stream, const float* input, size_t count)
+{
+	return stream ? stream->push(stream->f32.get(), input, count) : 0;
+}
+
+size_t vv_stream_push_f64(vv_stream* stream, const double* input, size_t count)
+{
+	return stream ? stream->push(stream->f64.get(), input, count) : 0;
+}
+
+size_t vv_stream_pull_f32(vv_stream* stream, float* output, size_t count)
+{
+	return stream ? stream->pull(stream->f32.get(), output, count) : 0;
+}
+
+size_t vv_stream_pull_f64(vv_stream* stream, double* output, size_t count)
+{
+	return stream ? stream->pull(stream->f64.get(), output, count) : 0;
+}
+
+size_t vv_stream_available(const vv_stream* stream)
+{
+	if (!stream)
+		return 0;
+
+	if (stream->f64)
+		return stream->f64->available();
+
+	return stream->f32->available();
+}
+
+vv_status vv_stream_set_pitch_shift(vv_stream* stream, double ratio)
+{
+	if (!stream || !is_positive(ratio))
+		return VV_INVALID_ARGUMENT;
+
+	stream->settings.pitch_shift = std::min(std::max(ratio, minimum_ratio), maximum_ratio);
+	return VV_OK;
+}
+
+vv_status vv_stream_set_formant_shift(vv_stream* stream, double ratio)
+{
+	if (!stream || !is_positive(ratio))
+		return VV_INVALID_ARGUMENT;
+
+	stream->settings.formant_shift = std::min(std::max(ratio, minimum_ratio), maximum_ratio);
+	return VV_OK;
+}
+
+vv_status vv_stream_set_input_pitch(vv_stream* stream, double hz)
+{
+	if (!stream || !std::isfinite(hz) || hz < 0.0)
+		return VV_INVALID_ARGUMENT;
+
+	// a longer period than a frame cannot be synthesized
+	if (hz != 0.0 && hz < stream->sample_rate / static_cast<double>(vv::processor<float>::buffer_size))
+		return VV_INVALID_ARGUMENT;
+
+	stream->settings.input_hz = hz;
+	return VV_OK;
+}
+
+vv_status vv_stream_set_detector(vv_stream* stream, vv_detector detector)
+{
+	if (!stream || detector < VV_DETECTOR_NSDF || detector > VV_DETECTOR_AMDF)
+		return VV_INVALID_ARGUMENT;
+
+	auto type = static_cast<vv::detector_type>(detector);
+
+	if (stream->f32)
+		stream->f32->get_stream().set_detector(type);
+
+	if (stream->f64)
+		stream->f64->get_stream().set_detector(type);
+
+	return VV_OK;
+}
+
+vv_status vv_stream_set_pitch_index(vv_stream* stream, const char* path)
+{
+	if (!stream)
+		return VV_INVALID_ARGUMENT;
+
+	try
+	{
+		std::shared_ptr<const vv::pitch_index> index;
+
+		if (path)
+			index = std::make_shared<vv::pitch_index>(path);
+
+		if (stream->f32)
+			stream->f32->get_stream().set_pitch_index(index);
+
+		if (stream->f64)
+			stream->f64->get_stream().set_pitch_index(index);
+
+		return VV_OK;
+	}
+	catch (...)
+	{
+		return VV_IO_ERROR;
+	}
+}
+
+vv_analyzer* vv_analyzer_create(const vv_config* config, vv_detector detector, const char* path)
+{
+	if (!config || !path || !is_positive(config->sample_rate) || (config->format != VV_FLOAT32 && config->format != VV_FLOAT64)
+		|| detector < VV_DETECTOR_NSDF || detector > VV_DETECTOR_AMDF)
+		return nullptr;
+
+	try
+	{
+		auto result = std::make_unique<vv_analyzer>();
+
+		if (config->format == VV_FLOAT64)
+			result->f64 = make_analyzer<double>(*config, detector, path);
+		else
+			result->f32 = make_analyzer<float>(*config, detector, path);
+
+		return result.release();
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+vv_status vv_analyzer_push_f32(vv_analyzer* analyzer, const float* input, size_t count)
+{
+	return analyzer ? analyzer->push(analyzer->f32.get(), input, count) : VV_INVALID_ARGUMENT;
+}
+
+vv_status vv_analyzer_push_f64(vv_analyzer* analyzer, const double* input, size_t count)
+{
+	return analyzer ? analyzer->push(analyzer->f64.get(), input, count) : VV_INVALID_ARGUMENT;
+}
+
+vv_status vv_analyzer_finish(vv_analyzer* analyzer)
+{
+	if (!analyzer || analyzer->finished)
+		return VV_INVALID_ARGUMENT;
+
+	analyzer->finished = true;
+
+	try
+	{
+		if (analyzer->f32)
+			analyzer->f32->close();
+
+		if (analyzer->f64)
+			analyzer->f64->close();
+
+		return VV_OK;
+	}
+	catch (...)
+	{
+		return VV_IO_ERROR;
+	}
+}
+
+void vv_analyzer_destroy(vv_analyzer* analyzer)
+{
+	delete analyzer;
+}
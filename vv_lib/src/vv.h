@@ -0,0 +1,160 @@
+/*
+ * C interface to the vv pitch and formant shifter, for embedding without a plugin host.
+ *
+ * A stream consumes input with vv_stream_push and produces output with vv_stream_pull,
+ * in chunks of any size. Output lags input by vv_stream_latency samples; the first
+ * latency samples pulled are silence. At the end of the input, push vv_stream_latency
+ * samples of silence (pulling as you go) to get the rest of the output.
+ *
+ * All memory is allocated by vv_stream_create. With threads set to 0 or 1, no other
+ * function allocates, locks or blocks, so push and pull are safe to call from a
+ * real-time thread. With more threads, a push that completes a batch locks and waits
+ * for the worker threads, so such a stream is for offline use only.
+ * A stream must not be used from more than one thread at a time.
+ *
+ * Re-renders of a known input can skip pitch detection: an analyzer writes the pitch of the
+ * whole input to an index file once, and vv_stream_set_pitch_index makes a stream read the
+ * pitch from it instead of detecting it.
+ */
+#ifndef VV_H
+#define VV_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(VV_LIB_EXPORTS)
+#define VV_API __declspec(dllexport)
+#else
+#define VV_API __declspec(dllimport)
+#endif
+#else
+#define VV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vv_stream vv_stream;
+typedef struct vv_analyzer vv_analyzer;
+
+typedef enum vv_sample_format
+{
+	VV_FLOAT32 = 0,
+	VV_FLOAT64 = 1
+} vv_sample_format;
+
+typedef enum vv_detector
+{
+	VV_DETECTOR_NSDF = 0,
+	VV_DETECTOR_YIN = 1,
+	VV_DETECTOR_AMDF = 2
+} vv_detector;
+
+typedef enum vv_status
+{
+	VV_OK = 0,
+	VV_INVALID_ARGUMENT = -1,
+	VV_IO_ERROR = -2
+} vv_status;
+
+typedef struct vv_config
+{
+	double sample_rate;
+
+	/* Sample type of every push and pull on the stream; processing runs in the same width. */
+	vv_sample_format format;
+
+	/*
+	 * 0 or 1 renders frame by frame on the calling thread. N > 1 renders batches of N frames
+	 * on N threads, for offline use only (push then blocks); latency grows to N frames.
+	 * N is capped at 8.
+	 */
+	unsigned int threads;
+
+	/*
+	 * The fastest FFT configuration for this machine is measured on first use (a few milliseconds)
+	 * and kept in a wisdom file. NULL uses $VV_FFT_WISDOM or a per-user cache directory;
+	 * an empty string keeps it in memory only, so it is measured once per process.
+	 */
+	const char* fft_wisdom_path;
+
+	/* 0 skips the measurement and the wisdom file and uses a default FFT configuration. */
+	int fft_measure;
+} vv_config;
+
+/*
+ * Fills config with 44100 Hz, VV_FLOAT32, a single thread and measured FFT wisdom at the default
+ * location. Initialize every config with it, so fields added later get their defaults.
+ */
+VV_API void vv_config_init(vv_config* config);
+
+/* Returns NULL if config is invalid or allocation fails. */
+VV_API vv_stream* vv_stream_create(const vv_config* config);
+
+VV_API void vv_stream_destroy(vv_stream* stream);
+
+/* Delay from input to output in samples. Constant for the lifetime of the stream. */
+VV_API size_t vv_stream_latency(const vv_stream* stream);
+
+/*
+ * Consumes up to count input samples and returns how many were taken. Fewer than count are
+ * taken only when output is waiting to be pulled; pull and push the rest again.
+ * Push and pull take nothing (return 0) when their type does not match the configured format.
+ */
+VV_API size_t vv_stream_push_f32(vv_stream* stream, const float* input, size_t count);
+VV_API size_t vv_stream_push_f64(vv_stream* stream, const double* input, size_t count);
+
+/* Writes up to count output samples and returns how many were written. */
+VV_API size_t vv_stream_pull_f32(vv_stream* stream, float* output, size_t count);
+VV_API size_t vv_stream_pull_f64(vv_stream* stream, double* output, size_t count);
+
+/* Number of output samples ready to pull. */
+VV_API size_t vv_stream_available(const vv_stream* stream);
+
+/*
+ * Frequency ratios; 1 leaves pitch or formant unchanged. Take effect from the next frame.
+ * Ratios outside [0.5, 2] (one octave either way) are clamped to it.
+ */
+VV_API vv_status vv_stream_set_pitch_shift(vv_stream* stream, double ratio);
+VV_API vv_status vv_stream_set_formant_shift(vv_stream* stream, double ratio);
+
+/*
+ * Fundamental frequency of the input from an external tracker, or 0 to detect it.
+ * Nonzero values must be at least sample_rate / 4096, whose period fills a whole frame.
+ */
+VV_API vv_status vv_stream_set_input_pitch(vv_stream* stream, double hz);
+
+VV_API vv_status vv_stream_set_detector(vv_stream* stream, vv_detector detector);
+
+/*
+ * Makes the stream take the pitch of each frame from the index at path, written by an analyzer
+ * with the same sample rate, instead of detecting it. The index must describe the input pushed
+ * since the stream was created; frames past its end are detected again. NULL detaches the index.
+ * Opens and maps the file, so it is not real-time safe. Returns VV_IO_ERROR if the file cannot
+ * be read or does not match the stream.
+ */
+VV_API vv_status vv_stream_set_pitch_index(vv_stream* stream, const char* path);
+
+/*
+ * Creates an analyzer that detects the pitch of input with detector and writes it to an index
+ * at path, replacing any file there. Uses the sample rate and format of config; threads is ignored.
+ * Returns NULL if config is invalid or the file cannot be created.
+ */
+VV_API vv_analyzer* vv_analyzer_create(const vv_config* config, vv_detector detector, const char* path);
+
+/* Consumes count input samples, starting from the first sample the stream will be given. */
+VV_API vv_status vv_analyzer_push_f32(vv_analyzer* analyzer, const float* input, size_t count);
+VV_API vv_status vv_analyzer_push_f64(vv_analyzer* analyzer, const double* input, size_t count);
+
+/* Analyzes the last partial frame and completes the index. Nothing can be pushed afterwards. */
+VV_API vv_status vv_analyzer_finish(vv_analyzer* analyzer);
+
+/* Destroying an analyzer that was not finished leaves an index that covers the full frames pushed. */
+VV_API void vv_analyzer_destroy(vv_analyzer* analyzer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif